@@ -0,0 +1,1081 @@
+"""
+Bitboard.py
+
+Bitboard position backend for the chess engine. The board is stored as twelve 64-bit
+piece bitboards (one per piece code) plus occupancy masks for each side, and a small
+mailbox so the piece on a square can be read without scanning the bitboards.
+
+Squares are numbered the same way as the (row, col) board layout: square = row * 8 + col,
+so square 0 is a8 and square 63 is h1.
+
+Author: Doan Quoc Kien
+"""
+FULL = 0xFFFFFFFFFFFFFFFF
+FILE_A = 0x0101010101010101
+FILE_H = FILE_A << 7
+NOT_FILE_A = FULL ^ FILE_A
+NOT_FILE_H = FULL ^ FILE_H
+ROW_3 = 0xFF << 40  # White pawns land here after a single push from their starting row
+ROW_6 = 0xFF << 16  # Black pawns land here after a single push from their starting row
+PROMOTION_ROWS = 0xFF | (0xFF << 56)
+
+# Moves are encoded in one int:
+#   bits 0-5   start square
+#   bits 6-11  end square
+#   bits 12-13 flag (NORMAL, EN_PASSANT, CASTLE, PROMOTION)
+#   bits 14-15 promotion piece type - 2 (knight, bishop, rook, queen)
+#   bits 16-20 moved piece code
+#   bits 21-25 captured piece code (the pawn for en passant), 0 if none
+# so a move can be made and taken back without reading the board.
+NORMAL = 0
+EN_PASSANT = 1
+CASTLE = 2
+PROMOTION = 3
+
+WHITE = 1
+BLACK = 2
+
+def _stepAttacks(offsets):
+    """
+    Build a table of single-step attack bitboards (knight, king) for every square.
+
+    Parameters:
+        offsets (list): (dr, dc) steps of the piece
+
+    Returns:
+        list: 64 attack bitboards
+    """
+    table = []
+    for sq in range(64):
+        r, c = divmod(sq, 8)
+        bb = 0
+        for dr, dc in offsets:
+            if 0 <= r + dr < 8 and 0 <= c + dc < 8:
+                bb |= 1 << ((r + dr) * 8 + c + dc)
+        table.append(bb)
+    return table
+
+def _rays(dr, dc):
+    """
+    Build the ray bitboards in one direction for every square, excluding the square itself.
+
+    Parameters:
+        dr, dc (int): direction of the ray
+
+    Returns:
+        list: 64 ray bitboards
+    """
+    table = []
+    for sq in range(64):
+        r, c = divmod(sq, 8)
+        bb = 0
+        r, c = r + dr, c + dc
+        while 0 <= r < 8 and 0 <= c < 8:
+            bb |= 1 << (r * 8 + c)
+            r, c = r + dr, c + dc
+        table.append(bb)
+    return table
+
+KNIGHT_ATTACKS = _stepAttacks([(2, 1), (2, -1), (-2, 1), (-2, -1), (1, 2), (1, -2), (-1, 2), (-1, -2)])
+KING_ATTACKS = _stepAttacks([(0, 1), (0, -1), (1, 0), (-1, 0), (1, 1), (1, -1), (-1, 1), (-1, -1)])
+# PAWN_ATTACKS[color][sq]: squares attacked by a pawn of that color standing on sq
+PAWN_ATTACKS = [None, _stepAttacks([(-1, -1), (-1, 1)]), _stepAttacks([(1, -1), (1, 1)])]
+
+# Rays towards higher square indices find their first blocker with the lowest set bit,
+# rays towards lower indices with the highest set bit
+RAY_S, RAY_E, RAY_SE, RAY_SW = _rays(1, 0), _rays(0, 1), _rays(1, 1), _rays(1, -1)
+RAY_N, RAY_W, RAY_NW, RAY_NE = _rays(-1, 0), _rays(0, -1), _rays(-1, -1), _rays(-1, 1)
+
+def _slidingAttacks(sq, occupied, positiveRays, negativeRays):
+    """
+    Walk the rays of a slider from sq, stopping at (and including) the first blocker in each direction.
+    Only used to fill the attack tables below.
+
+    Parameters:
+        sq (int): square of the slider
+        occupied (int): occupancy bitboard
+        positiveRays, negativeRays (tuple): ray tables towards higher / lower square indices
+
+    Returns:
+        int: attack bitboard
+    """
+    attacks = 0
+    for rays in positiveRays:
+        ray = rays[sq]
+        blockers = ray & occupied
+        if blockers:
+            ray ^= rays[(blockers & -blockers).bit_length() - 1]
+        attacks |= ray
+    for rays in negativeRays:
+        ray = rays[sq]
+        blockers = ray & occupied
+        if blockers:
+            ray ^= rays[blockers.bit_length() - 1]
+        attacks |= ray
+    return attacks
+
+def _buildSliderTables(positiveRays, negativeRays):
+    """
+    Precompute the attacks of a slider for every square and every blocker configuration.
+
+    Only the squares between the slider and the board edge can block it, so each square gets a
+    mask of those relevant squares, and its table maps every subset of the mask (the occupancy
+    bits picked out by the mask, as PEXT would) to the attack bitboard. The dict hashing of the
+    masked occupancy takes the place of the magic multiplication used by C engines.
+
+    Parameters:
+        positiveRays, negativeRays (tuple): ray tables towards higher / lower square indices
+
+    Returns:
+        tuple: (masks, tables), one mask and one {masked occupancy: attacks} dict per square
+    """
+    masks, tables = [], []
+    for sq in range(64):
+        mask = 0
+        for rays in positiveRays:
+            if rays[sq]:
+                mask |= rays[sq] ^ (1 << (rays[sq].bit_length() - 1))  # drop the edge square
+        for rays in negativeRays:
+            if rays[sq]:
+                mask |= rays[sq] ^ (rays[sq] & -rays[sq])
+        table = {}
+        subset = 0
+        while True:  # enumerate every subset of the mask (carry-rippler)
+            table[subset] = _slidingAttacks(sq, subset, positiveRays, negativeRays)
+            subset = (subset - mask) & mask
+            if subset == 0:
+                break
+        masks.append(mask)
+        tables.append(table)
+    return masks, tables
+
+ROOK_MASKS, ROOK_TABLES = _buildSliderTables((RAY_S, RAY_E), (RAY_N, RAY_W))
+BISHOP_MASKS, BISHOP_TABLES = _buildSliderTables((RAY_SE, RAY_SW), (RAY_NW, RAY_NE))
+
+def _buildBetween():
+    """
+    Build BETWEEN[a][b]: the squares strictly between a and b when they share a row, column or diagonal,
+    0 otherwise.
+
+    Returns:
+        list: 64 x 64 table of bitboards
+    """
+    table = [[0] * 64 for _ in range(64)]
+    for sq in range(64):
+        for rays in (RAY_S, RAY_E, RAY_SE, RAY_SW, RAY_N, RAY_W, RAY_NW, RAY_NE):
+            ray = rays[sq]
+            while ray:
+                bit = ray & -ray
+                other = bit.bit_length() - 1
+                table[sq][other] = rays[sq] ^ rays[other] ^ bit
+                ray ^= bit
+    return table
+
+BETWEEN = _buildBetween()
+
+def rookAttacks(sq, occupied):
+    """
+    Squares attacked by a rook on sq, stopping at (and including) the first blocker in each direction.
+    Hot loops inline this lookup instead of calling it.
+
+    Parameters:
+        sq (int): square of the rook
+        occupied (int): occupancy bitboard
+
+    Returns:
+        int: attack bitboard
+    """
+    return ROOK_TABLES[sq][occupied & ROOK_MASKS[sq]]
+
+def bishopAttacks(sq, occupied):
+    """
+    Squares attacked by a bishop on sq, stopping at (and including) the first blocker in each direction.
+    Hot loops inline this lookup instead of calling it.
+
+    Parameters:
+        sq (int): square of the bishop
+        occupied (int): occupancy bitboard
+
+    Returns:
+        int: attack bitboard
+    """
+    return BISHOP_TABLES[sq][occupied & BISHOP_MASKS[sq]]
+
+def _zobristKeys(count, seed=0x5EED):
+    """
+    Generate fixed pseudo-random 64-bit Zobrist keys with splitmix64, so every run (and every
+    worker process) hashes a position to the same key.
+
+    Parameters:
+        count (int): number of keys
+        seed (int): generator seed
+
+    Returns:
+        list: count 64-bit keys
+    """
+    keys = []
+    state = seed
+    for _ in range(count):
+        state = (state + 0x9E3779B97F4A7C15) & FULL
+        z = state
+        z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & FULL
+        z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & FULL
+        keys.append(z ^ (z >> 31))
+    return keys
+
+def _zobristTables():
+    """
+    Split the generated keys into the piece-square, side, castling and en passant tables.
+
+    Returns:
+        tuple: (pieces, side, castle, enPassant)
+    """
+    keys = _zobristKeys(12 * 64 + 1 + 4 + 8)
+    pieces = [[0] * 64 for _ in range(27)]
+    for i, piece in enumerate((11, 12, 13, 14, 15, 16, 21, 22, 23, 24, 25, 26)):
+        pieces[piece] = keys[i * 64:(i + 1) * 64]
+    castle = [0] * 16
+    for bits in range(16):
+        for i in range(4):
+            if bits >> i & 1:
+                castle[bits] ^= keys[769 + i]
+    return pieces, keys[768], castle, keys[773:781]
+
+# ZOBRIST_PIECES[piece][sq] is indexed by piece code like Position.pieces, ZOBRIST_SIDE is XORed in
+# when black is to move, ZOBRIST_CASTLE is indexed by the castling rights bits,
+# and ZOBRIST_EP is indexed by the file of the en passant square
+ZOBRIST_PIECES, ZOBRIST_SIDE, ZOBRIST_CASTLE, ZOBRIST_EP = _zobristTables()
+
+# PIECE_SQUARE_SCORES[piece][sq] is the material and piece-square score of a piece on a square, in hundredths
+# of a pawn from white's point of view. The evaluation fills it in (setPieceSquareScores) and Position keeps
+# a running total of it like the Zobrist key
+PIECE_SQUARE_SCORES = [[0] * 64 for _ in range(27)]
+
+def setPieceSquareScores(table):
+    """
+    Set the scores Position.pieceSquareScore adds up. A position keeps the total of the old scores until
+    its next setBoard, so this is done once at startup.
+
+    Parameters:
+        table (sequence): 27 rows of 64 ints, indexed by piece code and square
+    """
+    if len(table) != 27 or any(len(row) != 64 for row in table):
+        raise ValueError("piece-square table must have 27 rows of 64 squares")
+    for piece in range(27):
+        PIECE_SQUARE_SCORES[piece][:] = [int(score) for score in table[piece]]
+
+# Castling rights are 4 bits
+WHITE_KING_SIDE = 1
+WHITE_QUEEN_SIDE = 2
+BLACK_KING_SIDE = 4
+BLACK_QUEEN_SIDE = 8
+
+def _castleMask():
+    """
+    Rights kept when a piece moves from or to each square: a king leaving its square loses both rights,
+    and a rook leaving (or being captured on) its corner loses the right on that side.
+    """
+    mask = [15] * 64
+    mask[60] = 15 ^ (WHITE_KING_SIDE | WHITE_QUEEN_SIDE)
+    mask[63] = 15 ^ WHITE_KING_SIDE
+    mask[56] = 15 ^ WHITE_QUEEN_SIDE
+    mask[4] = 15 ^ (BLACK_KING_SIDE | BLACK_QUEEN_SIDE)
+    mask[7] = 15 ^ BLACK_KING_SIDE
+    mask[0] = 15 ^ BLACK_QUEEN_SIDE
+    return mask
+
+CASTLE_MASK = _castleMask()
+
+# Every undo record takes UNDO_SIZE slots of Position.undoStack: move, castling rights, en passant square,
+# halfmove clock, key and the white and black attack maps from before the move
+NULL_MOVE = 0  # pushed on the undo stack by makeNullMove, a8 to a8 is never a real move
+UNDO_SIZE = 7
+UNDO_STACK_PLIES = 1024
+
+def encodeMove(start, end, flag, piece, captured, promotion=5):
+    """
+    Pack a move into an int. Hot loops build the int inline instead of calling this.
+
+    Parameters:
+        start, end (int): start and end squares
+        flag (int): NORMAL, EN_PASSANT, CASTLE or PROMOTION
+        piece (int): code of the moving piece
+        captured (int): code of the captured piece, 0 if none
+        promotion (int): piece type (2-5) a promoting pawn becomes, ignored for other moves
+
+    Returns:
+        int: the encoded move
+    """
+    move = start | end << 6 | flag << 12 | piece << 16 | captured << 21
+    if flag == PROMOTION:
+        move |= (promotion - 2) << 14
+    return move
+
+def moveStart(move):
+    return move & 63
+
+def moveEnd(move):
+    return move >> 6 & 63
+
+def moveFlag(move):
+    return move >> 12 & 3
+
+def movePromotion(move):
+    """
+    Returns:
+        int: piece type (2-5) a promotion move promotes to
+    """
+    return (move >> 14 & 3) + 2
+
+def movePiece(move):
+    return move >> 16 & 31
+
+def moveCaptured(move):
+    return move >> 21 & 31
+
+def popCount(bb):
+    """
+    Number of set bits in a bitboard.
+    """
+    return bin(bb).count("1")
+
+class Position():
+    """
+    Chess position stored as bitboards, with the side to move, castling rights, en passant square and
+    halfmove clock. makeMove and undoMove keep everything (including the Zobrist key and the piece-square
+    score) up to date and save
+    what undo needs in a preallocated undo stack, so making and taking back moves allocates no objects.
+
+    Attributes:
+        squares (list): 64-entry mailbox of piece codes (0 for an empty square)
+        pieces (list): bitboard per piece code, indexed directly by the code (11-16, 21-26)
+        colors (list): occupancy bitboard of white (index 1) and black (index 2)
+        occupied (int): occupancy bitboard of both sides
+        whiteToMove (bool): side to move
+        castleRights (int): castling rights bits (WHITE_KING_SIDE, WHITE_QUEEN_SIDE, BLACK_KING_SIDE, BLACK_QUEEN_SIDE)
+        epSquare (int): square a pawn can capture en passant on, -1 if none
+        halfmoveClock (int): plies since the last capture or pawn move
+        key (int): Zobrist key of the position (pieces, side to move, castling rights, usable en passant file)
+        pawnKey (int): Zobrist key of the pawns alone, for the pawn structure cache
+        pieceSquareScore (int): sum of PIECE_SQUARE_SCORES over the pieces, in hundredths (white positive)
+        attacks (list): squares attacked by white (index 1) and black (index 2), kept up to date by makeMove
+            and undoMove, so attack and check tests are a bit test
+        undoStack (list): flat list of undo records, UNDO_SIZE slots per move
+        ply (int): number of moves on the undo stack
+    """
+
+    def __init__(self, board=None):
+        self.squares = [0] * 64
+        self.pieces = [0] * 27
+        self.colors = [0, 0, 0]
+        self.occupied = 0
+        self.key = 0
+        self.pawnKey = 0
+        self.pieceSquareScore = 0
+        self.whiteToMove = True
+        self.castleRights = 0
+        self.epSquare = -1
+        self.halfmoveClock = 0
+        self.attacks = [0, 0, 0]
+        self.undoStack = [0] * (UNDO_STACK_PLIES * UNDO_SIZE)
+        self.ply = 0
+        if board is not None:
+            self.setBoard(board)
+
+    def setBoard(self, board):
+        """
+        Load the piece placement from an 8x8 array of piece codes. The other state is kept and the undo
+        stack is cleared.
+
+        Parameters:
+            board (array-like): 8x8 board of piece codes
+        """
+        self.squares = [0] * 64
+        self.pieces = [0] * 27
+        self.colors = [0, 0, 0]
+        self.occupied = 0
+        self.pawnKey = 0
+        self.pieceSquareScore = 0
+        for r in range(8):
+            for c in range(8):
+                piece = int(board[r][c])
+                if piece != 0:
+                    self.putPiece(r * 8 + c, piece)
+        self.key = self.computeKey()
+        self.attacks = [0, self.attacksOf(WHITE), self.attacksOf(BLACK)]
+        self.ply = 0
+
+    def setState(self, whiteToMove, castleRights, epSquare, halfmoveClock):
+        """
+        Set the side to move, castling rights, en passant square and halfmove clock, and clear the undo stack.
+
+        Raises:
+            ValueError: castling rights out of range, or an en passant square that is not the empty square
+                behind a pawn the other side just pushed two squares
+        """
+        if not 0 <= castleRights <= 15 or not self.isValidEpSquare(whiteToMove, epSquare):
+            raise ValueError("invalid castling rights or en passant square")
+        self.whiteToMove = whiteToMove
+        self.castleRights = castleRights
+        self.epSquare = epSquare
+        self.halfmoveClock = halfmoveClock
+        self.key = self.computeKey()
+        self.ply = 0
+
+    def isValidEpSquare(self, whiteToMove, epSquare):
+        """
+        Returns:
+            bool: True if epSquare is -1 or the empty square a pawn of the side not to move just skipped
+                (row 2 with white to move, row 5 with black to move)
+        """
+        if epSquare == -1:
+            return True
+        if whiteToMove:
+            return 16 <= epSquare < 24 and self.squares[epSquare] == 0 and self.squares[epSquare + 8] == 21
+        return 40 <= epSquare < 48 and self.squares[epSquare] == 0 and self.squares[epSquare - 8] == 11
+
+    def computeKey(self):
+        """
+        Compute the Zobrist key from scratch. makeMove and undoMove keep it up to date incrementally.
+
+        Returns:
+            int: the Zobrist key
+        """
+        key = 0
+        for sq, piece in enumerate(self.squares):
+            if piece:
+                key ^= ZOBRIST_PIECES[piece][sq]
+        key ^= ZOBRIST_CASTLE[self.castleRights]
+        key ^= self.enPassantKey(self.epSquare, WHITE if self.whiteToMove else BLACK)
+        return key if self.whiteToMove else key ^ ZOBRIST_SIDE
+
+    def attacksOf(self, color):
+        """
+        All squares attacked by a side, computed from the bitboards. Pawns are shifted as a set, the other
+        pieces look up their attack tables.
+
+        Parameters:
+            color (int): 1 for white, 2 for black
+        Returns:
+            int: attack bitboard
+        """
+        pieces = self.pieces
+        occupied = self.occupied
+        base = color * 10
+        pawns = pieces[base + 1]
+        if color == WHITE:
+            attacks = ((pawns & NOT_FILE_A) >> 9) | ((pawns & NOT_FILE_H) >> 7)
+        else:
+            attacks = (((pawns & NOT_FILE_A) << 7) | ((pawns & NOT_FILE_H) << 9)) & FULL
+        king = pieces[base + 6]
+        if king:
+            attacks |= KING_ATTACKS[king.bit_length() - 1]
+        bb = pieces[base + 2]
+        while bb:
+            bit = bb & -bb
+            attacks |= KNIGHT_ATTACKS[bit.bit_length() - 1]
+            bb ^= bit
+        bb = pieces[base + 3] | pieces[base + 5]
+        while bb:
+            bit = bb & -bb
+            sq = bit.bit_length() - 1
+            attacks |= BISHOP_TABLES[sq][occupied & BISHOP_MASKS[sq]]
+            bb ^= bit
+        bb = pieces[base + 4] | pieces[base + 5]
+        while bb:
+            bit = bb & -bb
+            sq = bit.bit_length() - 1
+            attacks |= ROOK_TABLES[sq][occupied & ROOK_MASKS[sq]]
+            bb ^= bit
+        return attacks
+
+    def mobility(self, color):
+        """
+        Number of pseudo-legal moves of a side, counted with popcounts of its attack sets instead of
+        generating the moves, so nothing about the position changes. Either side can be counted, not only
+        the side to move. Castling and en passant are left out and a promotion counts once.
+
+        Parameters:
+            color (int): 1 for white, 2 for black
+        Returns:
+            int: move count
+        """
+        if color not in (WHITE, BLACK):
+            raise ValueError("invalid color")
+        pieces = self.pieces
+        occupied = self.occupied
+        notOwn = FULL ^ self.colors[color]
+        enemy = self.colors[3 - color]
+        empty = FULL ^ occupied
+        base = color * 10
+        pawns = pieces[base + 1]
+        if color == WHITE:
+            pushes = pawns >> 8 & empty
+            count = popCount(pushes) + popCount((pushes & ROW_3) >> 8 & empty)
+            count += popCount((pawns & NOT_FILE_A) >> 9 & enemy) + popCount((pawns & NOT_FILE_H) >> 7 & enemy)
+        else:
+            pushes = pawns << 8 & empty
+            count = popCount(pushes) + popCount((pushes & ROW_6) << 8 & empty)
+            count += popCount((pawns & NOT_FILE_A) << 7 & enemy) + popCount((pawns & NOT_FILE_H) << 9 & enemy)
+        king = pieces[base + 6]
+        if king:
+            count += popCount(KING_ATTACKS[king.bit_length() - 1] & notOwn)
+        bb = pieces[base + 2]
+        while bb:
+            bit = bb & -bb
+            count += popCount(KNIGHT_ATTACKS[bit.bit_length() - 1] & notOwn)
+            bb ^= bit
+        bb = pieces[base + 3] | pieces[base + 5]
+        while bb:
+            bit = bb & -bb
+            sq = bit.bit_length() - 1
+            count += popCount(BISHOP_TABLES[sq][occupied & BISHOP_MASKS[sq]] & notOwn)
+            bb ^= bit
+        bb = pieces[base + 4] | pieces[base + 5]
+        while bb:
+            bit = bb & -bb
+            sq = bit.bit_length() - 1
+            count += popCount(ROOK_TABLES[sq][occupied & ROOK_MASKS[sq]] & notOwn)
+            bb ^= bit
+        return count
+
+    def toBoard(self):
+        """
+        Returns:
+            list: 8x8 list of piece codes
+        """
+        return [self.squares[r * 8:r * 8 + 8] for r in range(8)]
+
+    def putPiece(self, sq, piece):
+        """
+        Place a piece on an empty square.
+        """
+        bit = 1 << sq
+        self.squares[sq] = piece
+        self.pieces[piece] |= bit
+        self.colors[piece // 10] |= bit
+        self.occupied |= bit
+        self.key ^= ZOBRIST_PIECES[piece][sq]
+        if piece % 10 == 1:
+            self.pawnKey ^= ZOBRIST_PIECES[piece][sq]
+        self.pieceSquareScore += PIECE_SQUARE_SCORES[piece][sq]
+
+    def removePiece(self, sq):
+        """
+        Remove the piece standing on a square.
+
+        Returns:
+            int: the removed piece code
+        """
+        piece = self.squares[sq]
+        bit = 1 << sq
+        self.squares[sq] = 0
+        self.pieces[piece] ^= bit
+        self.colors[piece // 10] ^= bit
+        self.occupied ^= bit
+        self.key ^= ZOBRIST_PIECES[piece][sq]
+        if piece % 10 == 1:
+            self.pawnKey ^= ZOBRIST_PIECES[piece][sq]
+        self.pieceSquareScore -= PIECE_SQUARE_SCORES[piece][sq]
+        return piece
+
+    def kingSquare(self, color):
+        """
+        Parameters:
+            color (int): 1 for white, 2 for black
+        Returns:
+            int: square of that side's king
+        """
+        return self.pieces[color * 10 + 6].bit_length() - 1
+
+    def enPassantKey(self, epSquare, us):
+        """
+        Zobrist key of an en passant square. The file only counts when a pawn of the side to move can
+        actually capture there, so positions that only differ by an unusable en passant square
+        hash the same for repetition detection.
+
+        Parameters:
+            epSquare (int): en passant square, -1 if none
+            us (int): side to move, 1 for white, 2 for black
+        Returns:
+            int: key to XOR into the position key, 0 if none
+        """
+        if epSquare >= 0 and PAWN_ATTACKS[3 - us][epSquare] & self.pieces[us * 10 + 1]:
+            return ZOBRIST_EP[epSquare & 7]
+        return 0
+
+    def isSquareAttacked(self, sq, byColor):
+        """
+        Check if a square is attacked by the given side, read from the attack maps.
+
+        Parameters:
+            sq (int): square to check
+            byColor (int): 1 for white attackers, 2 for black attackers
+        Returns:
+            True/False
+        """
+        return self.attacks[byColor] >> sq & 1 == 1
+
+    def inCheck(self):
+        """
+        Returns:
+            True/False: whether the side to move is in check
+        """
+        if self.whiteToMove:
+            return self.attacks[BLACK] & self.pieces[16] != 0
+        return self.attacks[WHITE] & self.pieces[26] != 0
+
+    def isAttackedAfter(self, sq, byColor, occupied, captured):
+        """
+        Check if a square would be attacked by the given side once the occupancy changed, without
+        touching the bitboards or relying on the attack maps. Used to test moves for legality
+        without making them.
+
+        Parameters:
+            sq (int): square to check
+            byColor (int): 1 for white attackers, 2 for black attackers
+            occupied (int): occupancy bitboard after the move
+            captured (int): bit of the square whose attacker was just captured (0 if none)
+        Returns:
+            True/False
+        """
+        pieces = self.pieces
+        base = byColor * 10
+        alive = FULL ^ captured
+        if KNIGHT_ATTACKS[sq] & pieces[base + 2] & alive:
+            return True
+        if PAWN_ATTACKS[3 - byColor][sq] & pieces[base + 1] & alive:
+            return True
+        if KING_ATTACKS[sq] & pieces[base + 6]:
+            return True
+        queens = pieces[base + 5]
+        if ROOK_TABLES[sq][occupied & ROOK_MASKS[sq]] & (pieces[base + 4] | queens) & alive:
+            return True
+        if BISHOP_TABLES[sq][occupied & BISHOP_MASKS[sq]] & (pieces[base + 3] | queens) & alive:
+            return True
+        return False
+
+    def movePieces(self, move):
+        """
+        Move a piece on the bitboards, including the rook of a castle move and the pawn taken en passant.
+        Only the pieces (and their part of the key) change.
+
+        Parameters:
+            move (int): encoded move
+        """
+        start = move & 63
+        end = move >> 6 & 63
+        flag = move >> 12 & 3
+        piece = self.removePiece(start)
+        if flag == EN_PASSANT:
+            self.removePiece((start & ~7) | (end & 7))
+        elif move >> 21:
+            self.removePiece(end)
+        if flag == PROMOTION:
+            piece = piece - 1 + (move >> 14 & 3) + 2
+        self.putPiece(end, piece)
+        if flag == CASTLE:
+            if end > start:  # kingside: rook jumps from the corner to the square the king crossed
+                self.putPiece(end - 1, self.removePiece(end + 1))
+            else:
+                self.putPiece(end + 1, self.removePiece(end - 2))
+
+    def unmovePieces(self, move):
+        """
+        Take back the piece changes of movePieces.
+
+        Parameters:
+            move (int): encoded move
+        """
+        start = move & 63
+        end = move >> 6 & 63
+        flag = move >> 12 & 3
+        captured = move >> 21 & 31
+        self.removePiece(end)
+        self.putPiece(start, move >> 16 & 31)
+        if flag == EN_PASSANT:
+            self.putPiece((start & ~7) | (end & 7), captured)
+        elif captured:
+            self.putPiece(end, captured)
+        elif flag == CASTLE:
+            if end > start:
+                self.putPiece(end + 1, self.removePiece(end - 1))
+            else:
+                self.putPiece(end - 2, self.removePiece(end + 1))
+
+    def makeMove(self, move):
+        """
+        Make a move: pieces, side to move, castling rights, en passant square, halfmove clock and key.
+        The previous state is pushed on the undo stack.
+
+        Parameters:
+            move (int): encoded move
+        """
+        stack = self.undoStack
+        top = self.ply * UNDO_SIZE
+        if top == len(stack):
+            stack.extend([0] * len(stack))  # only when a game outgrows the stack, never inside a search
+        castleRights = self.castleRights
+        epSquare = self.epSquare
+        key = self.key
+        stack[top] = move
+        stack[top + 1] = castleRights
+        stack[top + 2] = epSquare
+        stack[top + 3] = self.halfmoveClock
+        stack[top + 4] = key
+        attacks = self.attacks
+        stack[top + 5] = attacks[WHITE]
+        stack[top + 6] = attacks[BLACK]
+        self.ply += 1
+
+        us = WHITE if self.whiteToMove else BLACK
+        # XOR the old castling rights and en passant file out of the key before the pieces move
+        self.key = key ^ ZOBRIST_CASTLE[castleRights] ^ self.enPassantKey(epSquare, us) ^ ZOBRIST_SIDE
+        self.movePieces(move)
+        start = move & 63
+        end = move >> 6 & 63
+        piece = move >> 16 & 31
+        castleRights &= CASTLE_MASK[start] & CASTLE_MASK[end]
+        self.castleRights = castleRights
+        self.whiteToMove = not self.whiteToMove
+        if piece % 10 == 1:
+            self.halfmoveClock = 0
+            self.epSquare = (start + end) >> 1 if start - end in (16, -16) else -1
+        else:
+            self.halfmoveClock = 0 if move >> 21 else self.halfmoveClock + 1
+            self.epSquare = -1
+        self.key ^= ZOBRIST_CASTLE[castleRights] ^ self.enPassantKey(self.epSquare, 3 - us)
+        # The mover's attacks always change. The opponent's only change when it lost a piece or when a square
+        # it attacks was emptied or filled, which moves the end of one of its slider rays.
+        attacks[us] = self.attacksOf(us)
+        if move >> 21 or (1 << start | 1 << end) & attacks[3 - us] or move >> 12 & 3 == CASTLE:
+            attacks[3 - us] = self.attacksOf(3 - us)
+
+    def makeNullMove(self):
+        """
+        Pass the turn without moving a piece, for null move pruning in the search. The side to move must
+        not be in check. It is pushed on the undo stack as NULL_MOVE, so undoMove takes it back.
+        """
+        stack = self.undoStack
+        top = self.ply * UNDO_SIZE
+        if top == len(stack):
+            stack.extend([0] * len(stack))
+        epSquare = self.epSquare
+        stack[top] = NULL_MOVE
+        stack[top + 1] = self.castleRights
+        stack[top + 2] = epSquare
+        stack[top + 3] = self.halfmoveClock
+        stack[top + 4] = self.key
+        stack[top + 5] = self.attacks[WHITE]
+        stack[top + 6] = self.attacks[BLACK]
+        self.ply += 1
+        self.key ^= self.enPassantKey(epSquare, WHITE if self.whiteToMove else BLACK) ^ ZOBRIST_SIDE
+        self.epSquare = -1
+        self.halfmoveClock += 1
+        self.whiteToMove = not self.whiteToMove
+
+    def undoMove(self):
+        """
+        Take back the last move made with makeMove or makeNullMove.
+
+        Returns:
+            int: the move taken back
+        """
+        self.ply -= 1
+        top = self.ply * UNDO_SIZE
+        stack = self.undoStack
+        move = stack[top]
+        if move != NULL_MOVE:
+            self.unmovePieces(move)
+        self.castleRights = stack[top + 1]
+        self.epSquare = stack[top + 2]
+        self.halfmoveClock = stack[top + 3]
+        self.key = stack[top + 4]
+        attacks = self.attacks
+        attacks[WHITE] = stack[top + 5]
+        attacks[BLACK] = stack[top + 6]
+        self.whiteToMove = not self.whiteToMove
+        return move
+
+    def lastMove(self):
+        """
+        Returns:
+            int: the last move made, 0 if the undo stack is empty
+        """
+        return self.undoStack[(self.ply - 1) * UNDO_SIZE] if self.ply else 0
+
+    def addPawnMoves(self, us, pawns, target, moves):
+        """
+        Append the pushes and captures of the given pawns that land on a target square. A pawn reaching
+        the last row gets one move per promotion piece. En passant is generated separately.
+
+        Parameters:
+            us (int): 1 for white, 2 for black
+            pawns (int): bitboard of the pawns to move
+            target (int): bitboard of the squares the pawns may land on
+            moves (list): list the moves are appended to
+        """
+        append = moves.append
+        squares = self.squares
+        empty = FULL ^ self.occupied
+        enemy = self.colors[3 - us]
+        piece = (us * 10 + 1) << 16
+        # whole-board shifts, then recover the start square from the shift amount
+        if us == WHITE:
+            single = (pawns >> 8) & empty
+            double = ((single & ROW_3) >> 8) & empty
+            captureLeft = ((pawns & NOT_FILE_A) >> 9) & enemy
+            captureRight = ((pawns & NOT_FILE_H) >> 7) & enemy
+            push, left, right = 8, 9, 7
+        else:
+            single = (pawns << 8) & empty
+            double = ((single & ROW_6) << 8) & empty
+            captureLeft = ((pawns & NOT_FILE_A) << 7) & enemy
+            captureRight = ((pawns & NOT_FILE_H) << 9) & enemy
+            push, left, right = -8, -7, -9
+        for targets, delta in ((single & target, push), (double & target, 2 * push),
+                               (captureLeft & target, left), (captureRight & target, right)):
+            while targets:
+                bit = targets & -targets
+                end = bit.bit_length() - 1
+                targets ^= bit
+                move = (end + delta) | end << 6 | piece | squares[end] << 21
+                if bit & PROMOTION_ROWS:
+                    move |= PROMOTION << 12
+                    append(move | 3 << 14)  # queen first
+                    append(move | 2 << 14)
+                    append(move | 1 << 14)
+                    append(move)
+                else:
+                    append(move)
+
+    def getPseudoLegalMoves(self):
+        """
+        Generate all moves that follow the piece movement rules, without checking whether they
+        leave the own king in check.
+
+        Returns:
+            list: encoded moves for the side to move
+        """
+        moves = []
+        append = moves.append
+        us = WHITE if self.whiteToMove else BLACK
+        epSquare = self.epSquare
+        pieces = self.pieces
+        squares = self.squares
+        base = us * 10
+
+        pawns = pieces[base + 1]
+        self.addPawnMoves(us, pawns, FULL, moves)
+        if epSquare >= 0:
+            attackers = PAWN_ATTACKS[3 - us][epSquare] & pawns
+            while attackers:
+                bit = attackers & -attackers
+                append((bit.bit_length() - 1) | epSquare << 6 | EN_PASSANT << 12
+                       | (base + 1) << 16 | ((3 - us) * 10 + 1) << 21)
+                attackers ^= bit
+
+        # Pieces
+        notOwn = FULL ^ self.colors[us]
+        occupied = self.occupied
+        for piece in (base + 2, base + 3, base + 4, base + 5, base + 6):
+            bb = pieces[piece]
+            kind = piece - base
+            while bb:
+                bit = bb & -bb
+                start = bit.bit_length() - 1
+                bb ^= bit
+                if kind == 2:
+                    targets = KNIGHT_ATTACKS[start]
+                elif kind == 3:
+                    targets = BISHOP_TABLES[start][occupied & BISHOP_MASKS[start]]
+                elif kind == 4:
+                    targets = ROOK_TABLES[start][occupied & ROOK_MASKS[start]]
+                elif kind == 5:
+                    targets = (ROOK_TABLES[start][occupied & ROOK_MASKS[start]]
+                               | BISHOP_TABLES[start][occupied & BISHOP_MASKS[start]])
+                else:
+                    targets = KING_ATTACKS[start]
+                targets &= notOwn
+                start |= piece << 16
+                while targets:
+                    tbit = targets & -targets
+                    end = tbit.bit_length() - 1
+                    append(start | end << 6 | squares[end] << 21)
+                    targets ^= tbit
+
+        if not self.inCheck():  # Can't castle while in check
+            self.getCastleMoves(us, self.castleRights, moves)
+        return moves
+
+    def getCastleMoves(self, us, castleRights, moves):
+        """
+        Generate the castle moves available to a side that is not in check: the squares between king and
+        rook must be empty and the squares the king crosses must not be attacked.
+
+        Parameters:
+            us (int): 1 for white, 2 for black
+            castleRights (int): castling rights bits
+            moves (list): list the moves are appended to
+        """
+        if us == WHITE:
+            kingSide, queenSide, king = castleRights & WHITE_KING_SIDE, castleRights & WHITE_QUEEN_SIDE, 60
+        else:
+            kingSide, queenSide, king = castleRights & BLACK_KING_SIDE, castleRights & BLACK_QUEEN_SIDE, 4
+        if not (kingSide or queenSide) or self.squares[king] != us * 10 + 6:
+            return
+        them = 3 - us
+        occupied = self.occupied
+        if kingSide and not (occupied >> (king + 1)) & 0b11:
+            if not self.isSquareAttacked(king + 1, them) and not self.isSquareAttacked(king + 2, them):
+                moves.append(king | (king + 2) << 6 | CASTLE << 12 | (us * 10 + 6) << 16)
+        if queenSide and not (occupied >> (king - 3)) & 0b111:
+            if not self.isSquareAttacked(king - 1, them) and not self.isSquareAttacked(king - 2, them):
+                moves.append(king | (king - 2) << 6 | CASTLE << 12 | (us * 10 + 6) << 16)
+
+    def getLegalMoves(self):
+        """
+        Generate all legal moves. The pieces giving check and the pieces pinned to the king are found once,
+        then every piece only gets target squares that keep the king safe:
+        - in double check only the king can move
+        - in single check other pieces must capture the checker or block its line
+        - a pinned piece can only move along the line between the king and the pinning piece
+        - the king can only step to squares the enemy attack map does not cover, extended past the king
+          along the line of a checking slider
+        En passant can uncover an attack along the row of both pawns, so it is still tested by making the move.
+
+        Returns:
+            list: encoded moves for the side to move
+        """
+        moves = []
+        append = moves.append
+        us = WHITE if self.whiteToMove else BLACK
+        epSquare = self.epSquare
+        them = 3 - us
+        pieces = self.pieces
+        squares = self.squares
+        occupied = self.occupied
+        own = self.colors[us]
+        base = us * 10
+        enemyBase = them * 10
+        king = self.kingSquare(us)
+        enemyRooks = pieces[enemyBase + 4] | pieces[enemyBase + 5]
+        enemyBishops = pieces[enemyBase + 3] | pieces[enemyBase + 5]
+
+        kingBit = 1 << king
+        danger = self.attacks[them]
+        checkers = 0
+        if danger & kingBit:
+            checkers = ((KNIGHT_ATTACKS[king] & pieces[enemyBase + 2])
+                        | (PAWN_ATTACKS[us][king] & pieces[enemyBase + 1])
+                        | (ROOK_TABLES[king][occupied & ROOK_MASKS[king]] & enemyRooks)
+                        | (BISHOP_TABLES[king][occupied & BISHOP_MASKS[king]] & enemyBishops))
+            # A checking slider also attacks the squares behind the king on its line, which the attack map
+            # misses because the king blocks them there
+            sliders = checkers & (enemyRooks | enemyBishops)
+            withoutKing = occupied ^ kingBit
+            while sliders:
+                bit = sliders & -sliders
+                sq = bit.bit_length() - 1
+                sliders ^= bit
+                if ROOK_TABLES[sq][0] & kingBit:
+                    danger |= ROOK_TABLES[sq][withoutKing & ROOK_MASKS[sq]]
+                else:
+                    danger |= BISHOP_TABLES[sq][withoutKing & BISHOP_MASKS[sq]]
+
+        # King moves: any square the enemy does not attack
+        targets = KING_ATTACKS[king] & ~own & ~danger
+        start = king | (base + 6) << 16
+        while targets:
+            bit = targets & -targets
+            end = bit.bit_length() - 1
+            append(start | end << 6 | squares[end] << 21)
+            targets ^= bit
+        if checkers & (checkers - 1):
+            return moves  # double check: only the king can move
+
+        if checkers:
+            target = checkers | BETWEEN[king][checkers.bit_length() - 1]
+        else:
+            target = FULL ^ own
+            self.getCastleMoves(us, self.castleRights, moves)
+
+        # Pinned pieces: an own piece that is the only piece between the king and an enemy slider
+        pinned = 0
+        pinRays = {}
+        snipers = (ROOK_TABLES[king][0] & enemyRooks) | (BISHOP_TABLES[king][0] & enemyBishops)
+        while snipers:
+            bit = snipers & -snipers
+            sniper = bit.bit_length() - 1
+            snipers ^= bit
+            between = BETWEEN[king][sniper] & occupied
+            if between & own and not between & (between - 1):
+                pinned |= between
+                pinRays[between.bit_length() - 1] = BETWEEN[king][sniper] | bit
+
+        pawns = pieces[base + 1]
+        self.addPawnMoves(us, pawns & ~pinned, target, moves)
+        for sq, ray in pinRays.items():
+            if self.squares[sq] == base + 1:
+                self.addPawnMoves(us, 1 << sq, target & ray, moves)
+        if epSquare >= 0:
+            attackers = PAWN_ATTACKS[them][epSquare] & pawns
+            while attackers:
+                bit = attackers & -attackers
+                start = bit.bit_length() - 1
+                attackers ^= bit
+                move = start | epSquare << 6 | EN_PASSANT << 12 | (base + 1) << 16 | (enemyBase + 1) << 21
+                self.movePieces(move)
+                if not self.isAttackedAfter(king, them, self.occupied, 0):
+                    append(move)
+                self.unmovePieces(move)
+
+        for piece in (base + 2, base + 3, base + 4, base + 5):
+            bb = pieces[piece]
+            kind = piece - base
+            while bb:
+                bit = bb & -bb
+                start = bit.bit_length() - 1
+                bb ^= bit
+                if kind == 2:
+                    if bit & pinned:
+                        continue  # a pinned knight can never stay on the line
+                    targets = KNIGHT_ATTACKS[start] & target
+                elif kind == 3:
+                    targets = BISHOP_TABLES[start][occupied & BISHOP_MASKS[start]] & target
+                elif kind == 4:
+                    targets = ROOK_TABLES[start][occupied & ROOK_MASKS[start]] & target
+                else:
+                    targets = (ROOK_TABLES[start][occupied & ROOK_MASKS[start]]
+                               | BISHOP_TABLES[start][occupied & BISHOP_MASKS[start]]) & target
+                if bit & pinned:
+                    targets &= pinRays[start]
+                start |= piece << 16
+                while targets:
+                    tbit = targets & -targets
+                    end = tbit.bit_length() - 1
+                    append(start | end << 6 | squares[end] << 21)
+                    targets ^= tbit
+        return moves
+
+    def insufficientMaterial(self):
+        """
+        Check if neither side has enough material left to deliver checkmate.
+
+        Returns:
+            True/False
+        """
+        pieces = self.pieces
+        count = popCount(self.occupied)
+        # King vs. King
+        if count == 2:
+            return True
+        # King and Bishop/Knight vs. King
+        if count == 3 and (pieces[12] | pieces[13] | pieces[22] | pieces[23]):
+            return True
+        # King and Bishop vs. King and Bishop (same-colored bishops)
+        if count == 4 and pieces[13] and pieces[23]:
+            first, second = pieces[13].bit_length() - 1, pieces[23].bit_length() - 1
+            if (first // 8 + first % 8) % 2 == (second // 8 + second % 8) % 2:
+                return True
+        return False
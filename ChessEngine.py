@@ -5,183 +5,342 @@ Contains the GameState class and logic for chess rules, move generation, and val
 
 Author: Doan Quoc Kien
 """
+import os
+import struct
 import numpy as np
+import Bitboard as Bb
+
+START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+fenToPiece = {"P": 11, "N": 12, "B": 13, "R": 14, "Q": 15, "K": 16,
+              "p": 21, "n": 22, "b": 23, "r": 24, "q": 25, "k": 26}
+pieceToFen = {v: k for k, v in fenToPiece.items()}
+
+"""
+Layout of GameState.snapshot: 64 piece codes, side to move, castling bits, en passant square,
+halfmove clock, ply number and zobrist key (80 bytes)
+"""
+SNAPSHOT_FORMAT = struct.Struct("<64s?BbxHHQ")
+
+# Use the native position core when it has been built (python setup.py build_ext --inplace) and fall back
+# to the pure Python bitboards otherwise. Set CHESS_PURE_PYTHON=1 to force the fallback.
+Position = Bb.Position
+setPieceSquareScores = Bb.setPieceSquareScores
+if not os.environ.get("CHESS_PURE_PYTHON"):
+    try:
+        from chesscore import Position, setPieceSquareScores
+    except ImportError:
+        pass
+
+DRAW_MESSAGES = {
+    "fifty-move rule": "Draw by 50-move rule",
+    "threefold repetition": "Draw by threefold repetition",
+    "insufficient material": "Draw by insufficient material",
+}
 
 class GameState():
     """
     Represents the current state of a chess game.
 
     Attributes:
-        board (list): 2D list representing the board.
+        position (Position): The position (chesscore or Bitboard backend): pieces, side to move, castling
+            rights, en passant square, halfmove clock, zobrist key and the undo stack of the moves made.
+        board (np.ndarray): 8x8 array of piece codes, built from the bitboards on demand.
         whiteToMove (bool): True if it's white's turn.
-        moveLog (list): List of moves made and .
         whiteKingLocation (tuple): (row, col) of the white king.
         blackKingLocation (tuple): (row, col) of the black king.
         checkMate (bool): True if the game is in checkmate.
         draw (bool): True if the game is a draw.
-        enPassantPossible (tuple): If it's not None type, there is an en passant move available at (row, col)
-        currentCastlingRight (class): Handling castle right of White king side, Black king side, White queen side, and Blak queen side
-        enPassantPossibleLog (list): List of history of possible en passant for each move
+        enPassantPossible (tuple): If it's not empty, there is an en passant move available at (row, col)
+        castleRights (int): Castling rights bits (Bitboard.WHITE_KING_SIDE, WHITE_QUEEN_SIDE, BLACK_KING_SIDE, BLACK_QUEEN_SIDE)
+        zobristKey (int): 64-bit Zobrist key of the position (pieces, side to move, castling rights, en passant file)
         positionCounts (dict): Count the number of repeating move, mostly for checking three-fold-repetition
         fiftyMoveCounter (int): Count the number of move for checking draw by fifty-mive rule
+        startPly (int): Number of plies played before the position the game was set up from (FEN move number)
     """
 
-    def __init__(self):
+    def __init__(self, fen=START_FEN):
         """
         Initializes the game state.
         The chess board is an 8x8 2D list, each element is a numerical value:
         0: Empty square
         11-16: White pieces (pawn, knight, bishop, rook, queen, king)
         21-26: Black pieces (pawn, knight, bishop, rook, queen, king)
+
+        Parameters:
+            fen (str): Starting position in Forsyth-Edwards Notation, the standard start position by default
         """
-        self.board = np.array([
-            [24, 22, 23, 25, 26, 23, 22, 24],
-            [21, 21, 21, 21, 21, 21, 21, 21],
-            [ 0,  0,  0,  0,  0,  0,  0,  0],
-            [ 0,  0,  0,  0,  0,  0,  0,  0],
-            [ 0,  0,  0,  0,  0,  0,  0,  0],
-            [ 0,  0,  0,  0,  0,  0,  0,  0],
-            [11, 11, 11, 11, 11, 11, 11, 11],
-            [14, 12, 13, 15, 16, 13, 12, 14],
-        ])
-        self.whiteToMove = True
-        self.moveLog = []
-        self.moveFunctions = {1: self.getPawnMoves, 4: self.getRookMoves, 2: self.getKnightMoves,
-                              3: self.getBishopMoves, 5: self.getQueenMoves, 6: self.getKingMoves}
-        self.whiteKingLocation = (7, 4)  # for checking if the king is in check
-        self.blackKingLocation = (0, 4)  # for checking if the king is in check
+        self.position = Position()
+        self.simulation = False
+        self.loadFen(fen)
+
+    def setPosition(self, board, whiteToMove, castleBits, epSquare, fiftyMoveCounter, ply):
+        """
+        Set up a position and clear the history. Shared by loadFen and fromSnapshot.
+
+        Parameters:
+            board: 8x8 piece codes (any nested sequence of ints)
+            whiteToMove (bool): side to move
+            castleBits (int): castling rights bits
+            epSquare (int): en passant target square (row * 8 + col), -1 if none
+            fiftyMoveCounter (int): plies since the last capture or pawn move
+            ply (int): number of plies played since the start of the game, for the FEN move number
+        """
+        self.position.setBoard(board)
+        self.position.setState(whiteToMove, castleBits, epSquare, fiftyMoveCounter)
+        self.boardCache = None
         self.checkMate = False  # checkmate or not
         self.draw = False  # draw or not
-        self.enPassantPossible = ()  # store the square of the pawn that can be captured by en passant
-        self.currentCastlingRight = CastleRight(True, True, True, True)
-        self.castleRightsLog = [CastleRight(
-            self.currentCastlingRight.wks,
-            self.currentCastlingRight.bks,
-            self.currentCastlingRight.wqs,
-            self.currentCastlingRight.bqs
-        )]
-        self.enPassantPossibleLog = [()]
-        self.simulation = False
         self.positionCounts = {self.getBoardHash(): 1}
-        self.fiftyMoveCounter = 0
-    
+        self.startPly = ply
+
+    def loadFen(self, fen):
+        """
+        Set up the position described by a FEN string. The halfmove clock and move number are optional.
+
+        Parameters:
+            fen (str): position in Forsyth-Edwards Notation
+        Raises:
+            ValueError: the FEN cannot be parsed, a side does not have exactly one king, a pawn stands on the
+                first or last rank, the en passant square does not follow a two-square pawn push, or the side
+                not to move is in check
+        """
+        fields = fen.split()
+        if len(fields) < 4:
+            raise ValueError(f"Invalid FEN: {fen}")
+        board = [[0] * 8 for _ in range(8)]
+        rows = fields[0].split("/")
+        if len(rows) != 8:
+            raise ValueError(f"Invalid FEN placement: {fields[0]}")
+        for r, row in enumerate(rows):
+            c = 0
+            for ch in row:
+                if ch.isdigit():
+                    c += int(ch)
+                elif ch in fenToPiece and c < 8:
+                    board[r][c] = fenToPiece[ch]
+                    c += 1
+                else:
+                    raise ValueError(f"Invalid FEN placement: {fields[0]}")
+            if c != 8:
+                raise ValueError(f"Invalid FEN placement: {fields[0]}")
+        if any(sum(row.count(king) for row in board) != 1 for king in (16, 26)):
+            raise ValueError(f"Invalid FEN, each side needs exactly one king: {fen}")
+        if any(piece in (11, 21) for piece in board[0] + board[7]):
+            raise ValueError(f"Invalid FEN, pawn on the first or last rank: {fen}")
+        if fields[1] not in ("w", "b"):
+            raise ValueError(f"Invalid FEN side to move: {fields[1]}")
+        whiteToMove = fields[1] == "w"
+        # the side that just moved cannot have left its king in check
+        placement = Position(board)
+        them = Bb.BLACK if whiteToMove else Bb.WHITE
+        if placement.isSquareAttacked(placement.kingSquare(them), Bb.WHITE if whiteToMove else Bb.BLACK):
+            raise ValueError(f"Invalid FEN, the side not to move is in check: {fen}")
+        castleBits = 0
+        for bit, ch in enumerate("KQkq"):
+            if ch in fields[2]:
+                castleBits |= 1 << bit
+        epSquare = -1
+        if fields[3] != "-":
+            ep = fields[3]
+            if len(ep) != 2 or ep[0] not in Move.filesToCols or ep[1] != ("6" if whiteToMove else "3"):
+                raise ValueError(f"Invalid FEN en passant square: {ep}")
+            epSquare = Move.ranksToRows[ep[1]] * 8 + Move.filesToCols[ep[0]]
+            # the pawn that just moved two squares stands in front of the empty square it skipped
+            pawnSquare = epSquare + 8 if whiteToMove else epSquare - 8
+            pawn = 21 if whiteToMove else 11
+            if board[epSquare // 8][epSquare % 8] or board[pawnSquare // 8][pawnSquare % 8] != pawn:
+                raise ValueError(f"Invalid FEN en passant square, no pawn just moved past it: {ep}")
+        fiftyMoveCounter = int(fields[4]) if len(fields) > 4 else 0
+        fullMoves = int(fields[5]) if len(fields) > 5 else 1
+        self.setPosition(board, whiteToMove, castleBits, epSquare, fiftyMoveCounter,
+                         2 * (fullMoves - 1) + (0 if whiteToMove else 1))
+
+    def getFen(self):
+        """
+        Returns:
+            str: The current position in Forsyth-Edwards Notation
+        """
+        squares = self.position.squares
+        rows = []
+        for r in range(8):
+            row = ""
+            empty = 0
+            for piece in squares[r * 8:r * 8 + 8]:
+                if piece == 0:
+                    empty += 1
+                    continue
+                if empty:
+                    row += str(empty)
+                    empty = 0
+                row += pieceToFen[piece]
+            rows.append(row + (str(empty) if empty else ""))
+        castleBits = self.position.castleRights
+        rights = "".join(ch for bit, ch in enumerate("KQkq") if castleBits >> bit & 1) or "-"
+        enPassant = "-"
+        if self.enPassantPossible:
+            enPassant = Move.colsToFiles[self.enPassantPossible[1]] + Move.rowsToRanks[self.enPassantPossible[0]]
+        fullMoves = (self.startPly + self.position.ply) // 2 + 1
+        return f"{'/'.join(rows)} {'w' if self.whiteToMove else 'b'} {rights} {enPassant} {self.fiftyMoveCounter} {fullMoves}"
+
+    def snapshot(self):
+        """
+        Pack the current position (pieces, side to move, castling rights, en passant square, halfmove clock,
+        move number and zobrist key) into a fixed-size bytes object. It is cheap to copy and to send to
+        worker processes, and its size does not depend on the length of the game, since the history is left out.
+
+        Returns:
+            bytes: SNAPSHOT_FORMAT.size bytes, see fromSnapshot
+        """
+        position = self.position
+        return SNAPSHOT_FORMAT.pack(bytes(position.squares), position.whiteToMove, position.castleRights,
+                                    position.epSquare, position.halfmoveClock, self.startPly + position.ply,
+                                    position.key)
+
+    @classmethod
+    def fromSnapshot(cls, snapshot, positionCounts=None):
+        """
+        Build a game state from a snapshot. It has no move history: undoMove stops at the snapshot position.
+
+        Parameters:
+            snapshot (bytes): result of snapshot()
+            positionCounts (dict): optional repetition counts to carry over for threefold repetition
+        Returns:
+            GameState
+        """
+        squares, whiteToMove, castleBits, epSquare, fiftyMoveCounter, ply, _ = SNAPSHOT_FORMAT.unpack(snapshot)
+        gs = cls.__new__(cls)
+        gs.position = Position()
+        gs.simulation = False
+        gs.setPosition([squares[r * 8:r * 8 + 8] for r in range(8)], whiteToMove, castleBits, epSquare,
+                       fiftyMoveCounter, ply)
+        if positionCounts:
+            gs.positionCounts.update(positionCounts)
+        return gs
+
+    def clone(self):
+        """
+        Returns:
+            GameState: Copy of the current position without the move history
+        """
+        return GameState.fromSnapshot(self.snapshot())
+
+    @property
+    def board(self):
+        """
+        8x8 array of piece codes for display, saving and evaluation. It is rebuilt from the bitboards
+        only after the position changed.
+        """
+        if self.boardCache is None:
+            self.boardCache = np.array(self.position.toBoard())
+        return self.boardCache
+
+    @board.setter
+    def board(self, board):
+        self.position.setBoard(board)
+        self.boardCache = None
+
+    @property
+    def whiteToMove(self):
+        return self.position.whiteToMove
+
+    @whiteToMove.setter
+    def whiteToMove(self, whiteToMove):
+        # Only meant for setting up a position: changing the side clears the move history
+        position = self.position
+        if whiteToMove != position.whiteToMove:
+            position.setState(whiteToMove, position.castleRights, position.epSquare, position.halfmoveClock)
+            self.positionCounts = {self.getBoardHash(): 1}
+
+    @property
+    def castleRights(self):
+        return self.position.castleRights
+
+    @property
+    def enPassantPossible(self):
+        """
+        (row, col) of the en passant square, () if none.
+        """
+        epSquare = self.position.epSquare
+        return divmod(epSquare, 8) if epSquare >= 0 else ()
+
+    @property
+    def fiftyMoveCounter(self):
+        return self.position.halfmoveClock
+
+    @property
+    def zobristKey(self):
+        return self.position.key
+
+    @property
+    def whiteKingLocation(self):
+        """
+        (row, col) of the white king.
+        """
+        return divmod(self.position.kingSquare(Bb.WHITE), 8)
+
+    @property
+    def blackKingLocation(self):
+        """
+        (row, col) of the black king.
+        """
+        return divmod(self.position.kingSquare(Bb.BLACK), 8)
+
     def makeMove(self, move):
         """
-        Executes a move on the board.
+        Executes a move on the board. The position updates the side to move, castling rights, en passant
+        square, halfmove clock and zobrist key, and keeps what undoMove needs on its undo stack.
 
         Parameters:
-            move (Move): The move to make.
+            move (Move or int): The move to make, either a Move from the UI or an encoded move from the search.
 
         Returns:
             None
         """
-        self.board[move.startRow][move.startCol] = 0
-        self.board[move.endRow][move.endCol] = move.pieceMoved
-        self.whiteToMove = not self.whiteToMove #switch players
-        if move.pieceMoved == 16:
-            self.whiteKingLocation = (move.endRow, move.endCol)
-        elif move.pieceMoved == 26:
-            self.blackKingLocation = (move.endRow, move.endCol)
-
-        if move.isPawnPromotion:
-            promotionPiece = move.promotionChoice if move.promotionChoice else 5  # Default to Queen
-            self.board[move.endRow][move.endCol] = (10 if move.pieceMoved == 11 else 20) + promotionPiece
-        
-        #en passant
-        if move.isEnPassantMove:
-            self.board[move.startRow][move.endCol] = 0 #capturing the pawn
-
-        #update enPassantPossible
-        if move.pieceMoved % 10 == 1 and abs(move.startRow - move.endRow) == 2:
-            self.enPassantPossible = ((move.startRow + move.endRow) // 2, move.startCol)
-            self.enPassantPossibleLog.append((self.enPassantPossible[0], self.enPassantPossible[1]))
-        else:
-            self.enPassantPossible = ()
-            self.enPassantPossibleLog.append(())
-        
-        #update castling rights - whenever it is a rook or a king move      
-        self.updateCastleRights(move)
-        self.castleRightsLog.append(CastleRight(
-                                    self.currentCastlingRight.wks,
-                                    self.currentCastlingRight.bks,
-                                    self.currentCastlingRight.wqs,
-                                    self.currentCastlingRight.bqs
-                                    ))  
-                    
-        #castle
-        if move.isCastleMove:
-            if move.endCol - move.startCol == 2: #Kingside castle move
-                self.board[move.endRow][move.endCol - 1] = self.board[move.endRow][move.endCol + 1] #moves the rook
-                self.board[move.endRow][move.endCol + 1] = 0
-            else:
-                self.board[move.endRow][move.endCol + 1] = self.board[move.endRow][move.endCol - 2] #moves the rook
-                self.board[move.endRow][move.endCol - 2] = 0
-        
+        if isinstance(move, Move):
+            move = move.getCode()
+        self.position.makeMove(move)
+        self.boardCache = None
+
         # Update position counts for threefold repetition
-        boardString = self.getBoardHash()
-        if boardString in self.positionCounts:
-            self.positionCounts[boardString] += 1
-        else:
-            self.positionCounts[boardString] = 1
-        
-        # Update fifty-move counter
-        if move.pieceMoved % 10 == 1 or move.pieceCaptured != 0:
-            self.fiftyMoveCounter = 0  # Reset counter on pawn move or capture
-        else:
-            self.fiftyMoveCounter += 1
-        self.moveLog.append((move, self.fiftyMoveCounter)) #log the move so we can undo it later
+        positionCounts = self.positionCounts
+        key = self.position.key
+        positionCounts[key] = positionCounts.get(key, 0) + 1
+
+    def makeNullMove(self):
+        """
+        Pass the turn without moving, for null move pruning in the search. Not counted for repetitions.
+        Must not be used in check, take it back with undoNullMove.
+        """
+        self.position.makeNullMove()
+
+    def undoNullMove(self):
+        """
+        Take back makeNullMove.
+        """
+        self.position.undoMove()
+        self.checkMate = False
+        self.draw = False
 
     def getBoardHash(self):
         """
-        Generate a hash representation of the board for threefold repetition.
+        Generate a hash representation of the board for threefold repetition and the search transposition table.
         
         Returns:
-            int: The value of the hash
+            int: The value of the hash (the incrementally updated zobrist key)
         """
-        return hash((
-            tuple(tuple(row) for row in self.board),  # Board layout
-            self.whiteToMove,  # Current player's turn
-        ))
-    
-    def updateCastleRights(self, move):
+        return self.position.key
+
+    def computeZobristKey(self):
         """
-        Update Castling right when a piece moved
-        
-        Parameters:
-            move (Move): move just made
-        """
-        if move.pieceMoved == 16:
-            self.currentCastlingRight.wks = False
-            self.currentCastlingRight.wqs = False
-        elif move.pieceMoved == 26:
-            self.currentCastlingRight.bks = False
-            self.currentCastlingRight.bqs = False
-        elif move.pieceMoved == 14:
-            if move.startRow == 7:
-                if move.startCol == 0: # left rook
-                    self.currentCastlingRight.wqs = False
-                elif move.startCol == 7: #right took
-                    self.currentCastlingRight.wks = False
-        elif move.pieceMoved == 24:
-            if move.startRow == 0:
-                if move.startCol == 0: # left rook
-                    self.currentCastlingRight.bqs = False
-                elif move.startCol == 7: #right took
-                    self.currentCastlingRight.bks = False
-        if move.pieceCaptured == 14:
-            if move.endRow == 7:
-                if move.endCol == 0: # left rook
-                    self.currentCastlingRight.wqs = False
-                elif move.endCol == 7: #right took
-                    self.currentCastlingRight.wks = False
-        elif move.pieceCaptured == 24:
-            if move.endRow == 0:
-                if move.endCol == 0: # left rook
-                    self.currentCastlingRight.bqs = False
-                elif move.endCol == 7: #right took
-                    self.currentCastlingRight.bks = False
+        Compute the zobrist key of the current position from scratch. The position keeps it up to date
+        incrementally, so this is only useful for checking that.
+
+        Returns:
+            int: The zobrist key
+        """
+        return self.position.computeKey()
 
-    
     def undoMove(self):
         """
         Undoes the last move made.
@@ -189,58 +348,22 @@ class GameState():
         Returns:
             None
         """
+        if self.position.ply != 0:
+            # Decrement position count for threefold repetition
+            positionCounts = self.positionCounts
+            key = self.position.key
+            count = positionCounts.get(key, 0)
+            if count > 1:
+                positionCounts[key] = count - 1
+            elif count:
+                del positionCounts[key]
 
-        if len(self.moveLog) != 0:
-            move = self.moveLog.pop()[0]
+            self.position.undoMove()
+            self.boardCache = None
 
-            # Decrement position count for threefold repetition
-            boardString = self.getBoardHash()
-            if boardString in self.positionCounts:
-                self.positionCounts[boardString] -= 1
-                if self.positionCounts[boardString] == 0:
-                    del self.positionCounts[boardString]
-            
-            self.board[move.startRow][move.startCol] = move.pieceMoved
-            self.board[move.endRow][move.endCol] = move.pieceCaptured
-            if move.pieceMoved == 16:
-                self.whiteKingLocation = (move.startRow, move.startCol)
-            elif move.pieceMoved == 26:
-                self.blackKingLocation = (move.startRow, move.startCol)
-            self.whiteToMove = not self.whiteToMove #switch players
-
-            #undo en passant
-            if move.isEnPassantMove:
-                self.board[move.endRow][move.endCol] = 0
-                self.board[move.startRow][move.endCol] = move.pieceCaptured
-            self.enPassantPossibleLog.pop()
-            if self.enPassantPossibleLog[-1] != ():
-                self.enPassantPossible = (self.enPassantPossibleLog[-1][0], self.enPassantPossibleLog[-1][1])
-            else: self.enPassantPossible = ()
-            
-            #undo castling right
-            self.castleRightsLog.pop()
-            self.currentCastlingRight = CastleRight(self.castleRightsLog[-1].wks,
-                                                    self.castleRightsLog[-1].bks,
-                                                    self.castleRightsLog[-1].wqs,
-                                                    self.castleRightsLog[-1].bqs)
-
-            #undo castle move
-            if len(self.moveLog) != 0:
-                self.fiftyMoveCounter = self.moveLog[-1][1]
-            else:
-                self.fiftyMoveCounter = 0
-            if move.isCastleMove:
-                if move.endCol - move.startCol == 2: #kingside
-                    self.board[move.endRow][move.endCol + 1] = self.board[move.endRow][move.endCol - 1]
-                    self.board[move.endRow][move.endCol - 1] = 0
-                else:
-                    self.board[move.endRow][move.endCol - 2] = self.board[move.endRow][move.endCol + 1]
-                    self.board[move.endRow][move.endCol + 1] = 0
-            
             #undo checkmate and draw state
             self.checkMate = False
             self.draw = False
-            
 
     def insufficientMaterial(self):
         """
@@ -249,23 +372,7 @@ class GameState():
         Returns:
             True/False
         """
-        pieces = [piece for row in self.board for piece in row if piece != 0]
-
-        # King vs. King
-        if pieces == [16, 26]:
-            return True
-
-        # King and Bishop/Knight vs. King
-        if len(pieces) == 3 and 16 in pieces and 26 in pieces and (13 in pieces or 12 in pieces):
-            return True
-
-        # King and Bishop vs. King and Bishop (same-colored bishops)
-        if len(pieces) == 4 and 16 in pieces and 26 in pieces and pieces.count(13) == 2:
-            bishops = [(r, c) for r, row in enumerate(self.board) for c, piece in enumerate(row) if piece == 13]
-            if (bishops[0][0] + bishops[0][1]) % 2 == (bishops[1][0] + bishops[1][1]) % 2:
-                return True
-
-        return False
+        return self.position.insufficientMaterial()
 
     def squareUnderAttack(self, r, c):
         """
@@ -276,358 +383,95 @@ class GameState():
         Returns:
             True if the square is attacked, False otherwise.
         """
-        attackingColor = 10 if not self.whiteToMove else 20  # Determine the attacking color based on whiteToMove
-        directions = {
-            'knight': [(2, 1), (2, -1), (-2, 1), (-2, -1), (1, 2), (1, -2), (-1, 2), (-1, -2)],
-            'king': [(0, 1), (0, -1), (1, 0), (-1, 0), (1, 1), (1, -1), (-1, 1), (-1, -1)],
-            'rook': [(0, 1), (0, -1), (1, 0), (-1, 0)],
-            'bishop': [(1, 1), (1, -1), (-1, 1), (-1, -1)],
-        }
-
-        # Check for pawn attacks
-        pawnDirection = -1 if attackingColor == 20 else 1
-        if self.insideBoard(r + pawnDirection, c - 1) and self.board[r + pawnDirection][c - 1] == attackingColor + 1:
-            return True
-        if self.insideBoard(r + pawnDirection, c + 1) and self.board[r + pawnDirection][c + 1] == attackingColor + 1:
-            return True
-
-        # Check for knight attacks
-        for dr, dc in directions['knight']:
-            if self.insideBoard(r + dr, c + dc) and self.board[r + dr][c + dc] == attackingColor + 2:
-                return True
-
-        # Check for rook and queen attacks (horizontal and vertical)
-        for dr, dc in directions['rook']:
-            for i in range(1, 8):
-                nr, nc = r + dr * i, c + dc * i
-                if not self.insideBoard(nr, nc):
-                    break
-                piece = self.board[nr][nc]
-                if piece != 0:
-                    if piece == attackingColor + 4 or piece == attackingColor + 5:
-                        return True
-                    break
-
-        # Check for bishop and queen attacks (diagonals)
-        for dr, dc in directions['bishop']:
-            for i in range(1, 8):
-                nr, nc = r + dr * i, c + dc * i
-                if not self.insideBoard(nr, nc):
-                    break
-                piece = self.board[nr][nc]
-                if piece != 0:
-                    if piece == attackingColor + 3 or piece == attackingColor + 5:
-                        return True
-                    break
-
-        # Check for king attacks
-        for dr, dc in directions['king']:
-            if self.insideBoard(r + dr, c + dc) and self.board[r + dr][c + dc] == attackingColor + 6:
-                return True
-
-        return False
+        return self.position.isSquareAttacked(r * 8 + c, Bb.BLACK if self.whiteToMove else Bb.WHITE)
 
     def getValidMoves(self):
         """
         Generate all valid moves considering checks, castling, and special rules.
-        """
-        before = dict(self.positionCounts)
-        moves = self.getAllPossibleMoves()
-
-        # Add castling moves
-        if self.whiteToMove:
-            self.getCastleMoves(self.whiteKingLocation[0], self.whiteKingLocation[1], moves)
-        else:
-            self.getCastleMoves(self.blackKingLocation[0], self.blackKingLocation[1], moves)
-
-        # Filter out moves that leave the king in check
-        validMoves = []
-        for move in moves:
-            self.makeMove(move)
-            self.whiteToMove = not self.whiteToMove
-            if not self.inCheck():
-                validMoves.append(move)
-            self.whiteToMove = not self.whiteToMove
-            self.undoMove()
-        
-        after = self.positionCounts
-        if before != after:
-            print("=== positionCounts mutated during getValidMoves! ===")
-            for k in set(before) | set(after):
-                b = before.get(k, 0)
-                a = after.get(k, 0)
-                if a != b:
-                    print(f"  hash {k}: before={b}, after={a}")
-        # Handle draw conditions
-        if not validMoves:
-            if self.inCheck():
-                self.checkMate = True
-            else:
-                self.draw = True
-        elif self.fiftyMoveCounter >= 100:
-            self.draw = True
-            print("Draw by 50-move rule")
-        elif any(count >= 3 for count in list(self.positionCounts.values())):
-            self.draw = True
-            print("Draw by threefold repetition")
-        elif self.insufficientMaterial():
-            self.draw = True
-            print("Draw by insufficient material")
-        else:
-            self.checkMate = False
-            self.draw = False
 
-        return validMoves
-    
-    def inCheck(self):
-        """
-        Check if the current player is in check
-        
         Returns:
-            True/False
+            list: Move views for the UI. A promotion appears once, with the piece picked by promotionChoice.
         """
-        if self.whiteToMove:
-            return self.squareUnderAttack(self.whiteKingLocation[0], self.whiteKingLocation[1])
-        else:
-            return self.squareUnderAttack(self.blackKingLocation[0], self.blackKingLocation[1])
+        return [Move.fromCode(move, promotionChoice=None) for move in self.getValidMoveCodes()
+                if move >> 12 & 3 != Bb.PROMOTION or move >> 14 & 3 == 3]
 
-    def getAllPossibleMoves(self):
+    def getValidMoveCodes(self):
         """
-        Generate all possible moves without considering checks.
-        
+        Generate all valid moves as encoded ints (see Bitboard.encodeMove), with one move per promotion piece,
+        and update the checkmate and draw state.
+
         Returns:
-            List of Move that satisfy the standard chess rules 
+            list: encoded moves
         """
-        moves = []
-        for r in range(8):
-            for c in range(8):
-                piece = self.board[r][c]
-                if piece != 0 and ((piece // 10 == 1 and self.whiteToMove) or (piece // 10 == 2 and not self.whiteToMove)):
-                    self.moveFunctions[piece % 10](r, c, moves)
-        return moves
+        validMoves = self.getLegalMoveCodes()
+
+        # Handle draw conditions
+        outcome = self.getOutcome(validMoves)
+        self.checkMate = outcome == "checkmate"
+        self.draw = outcome is not None and not self.checkMate
+        if outcome in DRAW_MESSAGES:
+            print(DRAW_MESSAGES[outcome])
+
+        return validMoves
 
-    def getPawnMoves(self, r, c, moves):
+    def getOutcome(self, validMoves):
         """
-        Generate all possible moves for pawn.
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
-        """
-        if self.whiteToMove: # white pawns
-            if self.board[r - 1][c] == 0: # one-square advance
-                moves.append(Move((r, c), (r - 1, c), self.board))
-                if r == 6 and self.board[r - 2][c] == 0: #two-square advance
-                    moves.append(Move((r, c), (r - 2, c), self.board))
-            # enemy capture pieces
-            if c - 1 >= 0:
-                if self.board[r - 1][c - 1] // 10 == 2: 
-                    moves.append(Move((r, c), (r - 1, c - 1), self.board))
-                elif (r - 1, c - 1) == self.enPassantPossible:
-                    moves.append(Move((r, c), (r - 1, c - 1), self.board, isEnPassantMove=True))
-            if c + 1 < len(self.board):
-                if self.board[r - 1][c + 1] // 10 == 2:
-                    moves.append(Move((r, c), (r - 1, c + 1), self.board))
-                elif (r - 1, c + 1) == self.enPassantPossible:
-                    moves.append(Move((r, c), (r - 1, c + 1), self.board, isEnPassantMove=True))
-        else: #black pawns
-            if self.board[r + 1][c] == 0: # one-square advance
-                moves.append(Move((r, c), (r + 1, c), self.board))
-                if r == 1 and self.board[r + 2][c] == 0: #two-square advance
-                    moves.append(Move((r, c), (r + 2, c), self.board))
-            # enemy capture pieces
-            if c - 1 >= 0:
-                if self.board[r + 1][c - 1] // 10 == 1: 
-                    moves.append(Move((r, c), (r + 1, c - 1), self.board))
-                elif (r + 1, c - 1) == self.enPassantPossible:
-                    moves.append(Move((r, c), (r + 1, c - 1), self.board, isEnPassantMove=True))
-            if c + 1 < len(self.board):
-                if self.board[r + 1][c + 1] // 10 == 1:
-                    moves.append(Move((r, c), (r + 1, c + 1), self.board))
-                elif (r + 1, c + 1) == self.enPassantPossible:
-                    moves.append(Move((r, c), (r + 1, c + 1), self.board, isEnPassantMove=True))
-
-    def getRookMoves(self, r, c, moves):
-        """
-        Generate all possible moves for rook.
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
-        """
-        curr_turn = 2
-        op_turn = 1
-        if self.whiteToMove:
-            curr_turn = 1
-            op_turn = 2
-        for cur_c in range(c + 1, 8): # move to the right
-            if self.board[r][cur_c] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (r, cur_c), self.board))
-            if self.board[r][cur_c] // 10 == op_turn:
-                break
-        for cur_c in range(c - 1, -1, -1): # move to the left
-            if self.board[r][cur_c] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (r, cur_c), self.board))
-            if self.board[r][cur_c] // 10 == op_turn:
-                break
-        for cur_r in range(r + 1, 8): # move down
-            if self.board[cur_r][c] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (cur_r, c), self.board))
-            if self.board[cur_r][c] // 10 == op_turn:
-                break
-        for cur_r in range(r - 1, -1, -1): # move up
-            if self.board[cur_r][c] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (cur_r, c), self.board))
-            if self.board[cur_r][c] // 10 == op_turn:
-                break
-
-    def insideBoard(self, r, c):
-        """
-        Return True if a square is inside the board
-        
+        How the game stands, without touching the checkmate and draw state. The search uses it at every node.
+
         Parameters:
-            r, c (int): row and column need checking
+            validMoves (list): legal moves of the position (getLegalMoveCodes)
         Returns:
-            True/False
+            str or None: "checkmate", "stalemate", "fifty-move rule", "threefold repetition" or
+                "insufficient material", None while the game goes on
         """
-        return 0 <= r < 8 and 0 <= c < 8
+        if not validMoves:
+            return "checkmate" if self.inCheck() else "stalemate"
+        if self.fiftyMoveCounter >= 100:
+            return "fifty-move rule"
+        if self.positionCounts.get(self.position.key, 0) >= 3:
+            return "threefold repetition"
+        if self.insufficientMaterial():
+            return "insufficient material"
+        return None
     
-    def getKnightMoves(self, r, c, moves):
+    def getLegalMoveCodes(self):
         """
-        Generate all possible moves for knight.
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
+        Generate all legal moves as encoded ints without touching the checkmate and draw state.
+        Used by perft and anything else that only needs the moves.
+
+        Returns:
+            list: encoded moves
         """
-        curr_turn = 2
-        if self.whiteToMove:
-            curr_turn = 1
-        directions = [(2, 1), (2, -1), (-2, 1), (-2, -1), (1, 2), (1, -2), (-1, 2), (-1, -2)] #L-shaped moves
-        for i in directions:
-            if self.insideBoard(r + i[0], c + i[1]):
-                if self.board[r + i[0]][c + i[1]] // 10 != curr_turn:
-                    moves.append(Move((r, c), (r + i[0], c + i[1]), self.board))
+        return self.position.getLegalMoves()
 
-    def getBishopMoves(self, r, c, moves):
+    def hasNonPawnMaterial(self):
         """
-        Generate all possible moves for knight.
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
-        """
-        curr_turn = 2
-        op_turn = 1
-        if self.whiteToMove:
-            curr_turn = 1
-            op_turn = 2
-        # Move down-right
-        currRow = r + 1
-        currColumn = c + 1
-        while self.insideBoard(currRow, currColumn):
-            if self.board[currRow][currColumn] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (currRow, currColumn), self.board))
-            if self.board[currRow][currColumn] // 10 == op_turn:
-                break
-            currRow += 1
-            currColumn += 1
-        
-        #Move down-left
-        currRow = r + 1
-        currColumn = c - 1
-        while self.insideBoard(currRow, currColumn):
-            if self.board[currRow][currColumn] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (currRow, currColumn), self.board))
-            if self.board[currRow][currColumn] // 10 == op_turn:
-                break
-            currRow += 1
-            currColumn -= 1
-
-        #Move up-right
-        currRow = r - 1
-        currColumn = c + 1
-        while self.insideBoard(currRow, currColumn):
-            if self.board[currRow][currColumn] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (currRow, currColumn), self.board))
-            if self.board[currRow][currColumn] // 10 == op_turn:
-                break
-            currRow -= 1
-            currColumn += 1
-        
-        #Move up-left
-        currRow = r - 1
-        currColumn = c - 1
-        while self.insideBoard(currRow, currColumn):
-            if self.board[currRow][currColumn] // 10 == curr_turn:
-                break
-            moves.append(Move((r, c), (currRow, currColumn), self.board))
-            if self.board[currRow][currColumn] // 10 == op_turn:
-                break
-            currRow -= 1
-            currColumn -= 1
-    def getQueenMoves(self, r, c, moves):
-        """
-        Generate all possible moves for queen. Since queen are basically rook and bishop combine, we could just get the rook and bishop moves at this piece
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
+        Check if the side to move has a knight, bishop, rook or queen. Without one, passing the turn may be
+        better than any move (zugzwang), so the search does not try a null move.
+
+        Returns:
+            True/False
         """
-        self.getRookMoves(r, c, moves)
-        self.getBishopMoves(r, c, moves)
+        pieces = self.position.pieces
+        base = 10 if self.whiteToMove else 20
+        return (pieces[base + 2] | pieces[base + 3] | pieces[base + 4] | pieces[base + 5]) != 0
 
-    def getKingMoves(self, r, c, moves):
+    def inCheck(self):
         """
-        Generate all possible moves for king.
+        Check if the current player is in check
         
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
-        """
-        curr_turn = 2
-        if self.whiteToMove:
-            curr_turn = 1
-        directions = [(0, 1), (0, -1), (-1, 1), (-1, -1), (1, 0), (-1, 0), (1, 1), (1, -1)] #one-space moves
-        for i in directions:
-            if self.insideBoard(r + i[0], c + i[1]):
-                if self.board[r + i[0]][c + i[1]] // 10 != curr_turn:
-                    moves.append(Move((r, c), (r + i[0], c + i[1]), self.board))
-    
-    def getCastleMoves(self, r, c, moves):
+        Returns:
+            True/False
         """
-        Generate all valid castle moves at r, c for the current turn.
-        
-        Parameters:
-            r, c (int):  row and column as positions
-            moves (list of Moves as reference): list of moves
-        """
-        if self.inCheck():
-            return  # Can't castle while in check
-
-        # Kingside Castle Moves
-        if (self.whiteToMove and self.currentCastlingRight.wks) or (not self.whiteToMove and self.currentCastlingRight.bks):
-            if c + 2 < 8 and self.board[r][c + 1] == 0 and self.board[r][c + 2] == 0:
-                if not self.squareUnderAttack(r, c + 1) and not self.squareUnderAttack(r, c + 2):
-                    moves.append(Move((r, c), (r, c + 2), self.board, isCastleMove=True))
-
-        # Queenside Castle Moves
-        if (self.whiteToMove and self.currentCastlingRight.wqs) or (not self.whiteToMove and self.currentCastlingRight.bqs):
-            if c - 3 >= 0 and self.board[r][c - 1] == 0 and self.board[r][c - 2] == 0 and self.board[r][c - 3] == 0:
-                if not self.squareUnderAttack(r, c - 1) and not self.squareUnderAttack(r, c - 2):
-                    moves.append(Move((r, c), (r, c - 2), self.board, isCastleMove=True))
+        return self.position.inCheck()
+
 class Move():
     """
-    Represents a chess move.
+    Thin view of an encoded move (see Bitboard.encodeMove), built only for the UI and notation.
+    Move generation and the search work on the encoded ints directly.
 
     Attributes:
+        code (int): The encoded move.
         startRow (int): Starting row.
         startCol (int): Starting column.
         endRow (int): Ending row.
@@ -654,25 +498,87 @@ class Move():
 
 
     def __init__(self, startSquare, endSquare, board, isEnPassantMove = False, isCastleMove = False, promotionChoice = None):
-        self.startRow = startSquare[0]
-        self.startCol = startSquare[1]
-        self.endRow = endSquare[0]
-        self.endCol = endSquare[1]
-        self.pieceMoved = board[self.startRow][self.startCol]
-        self.pieceCaptured = board[self.endRow][self.endCol]
-        self.moveID = self.startRow * 1000 + self.startCol * 100 + self.endRow * 10 + self.endCol
-
-        #pawn promotion
-        self.isPawnPromotion = (self.pieceMoved == 11 and self.endRow == 0) or (self.pieceMoved == 21 and self.endRow == 7)
+        start = startSquare[0] * 8 + startSquare[1]
+        end = endSquare[0] * 8 + endSquare[1]
+        pieceMoved = int(board[startSquare[0]][startSquare[1]])
+        pieceCaptured = int(board[endSquare[0]][endSquare[1]])
+        flag = Bb.NORMAL
+        if isEnPassantMove:
+            flag = Bb.EN_PASSANT
+            pieceCaptured = 11 if pieceMoved == 21 else 21
+        elif isCastleMove:
+            flag = Bb.CASTLE
+        elif (pieceMoved == 11 and endSquare[0] == 0) or (pieceMoved == 21 and endSquare[0] == 7):
+            flag = Bb.PROMOTION
+        self.code = Bb.encodeMove(start, end, flag, pieceMoved, pieceCaptured, promotionChoice if promotionChoice else 5)
         self.promotionChoice = promotionChoice
 
-        #en passant
-        self.isEnPassantMove = isEnPassantMove
-        if self.isEnPassantMove:
-            self.pieceCaptured = 11 if self.pieceMoved == 21 else 21
+    @classmethod
+    def fromCode(cls, code, promotionChoice = -1):
+        """
+        Build the view of an encoded move.
+
+        Parameters:
+            code (int): encoded move
+            promotionChoice (int): piece to promote to; by default the one stored in the code
+        Returns:
+            Move
+        """
+        move = cls.__new__(cls)
+        move.code = code
+        if promotionChoice == -1:
+            promotionChoice = Bb.movePromotion(code) if Bb.moveFlag(code) == Bb.PROMOTION else None
+        move.promotionChoice = promotionChoice
+        return move
+
+    def getCode(self):
+        """
+        Returns:
+            int: The encoded move with promotionChoice applied (queen if none was chosen)
+        """
+        if not self.isPawnPromotion:
+            return self.code
+        return (self.code & ~(3 << 14)) | ((self.promotionChoice if self.promotionChoice else 5) - 2) << 14
+
+    @property
+    def startRow(self):
+        return (self.code & 63) >> 3
+
+    @property
+    def startCol(self):
+        return self.code & 7
 
-        #castling
-        self.isCastleMove = isCastleMove
+    @property
+    def endRow(self):
+        return (self.code >> 6 & 63) >> 3
+
+    @property
+    def endCol(self):
+        return self.code >> 6 & 7
+
+    @property
+    def pieceMoved(self):
+        return Bb.movePiece(self.code)
+
+    @property
+    def pieceCaptured(self):
+        return Bb.moveCaptured(self.code)
+
+    @property
+    def moveID(self):
+        return self.startRow * 1000 + self.startCol * 100 + self.endRow * 10 + self.endCol
+
+    @property
+    def isPawnPromotion(self):
+        return Bb.moveFlag(self.code) == Bb.PROMOTION
+
+    @property
+    def isEnPassantMove(self):
+        return Bb.moveFlag(self.code) == Bb.EN_PASSANT
+
+    @property
+    def isCastleMove(self):
+        return Bb.moveFlag(self.code) == Bb.CASTLE
 
     def __eq__(self, other):
         """
@@ -705,6 +611,18 @@ class Move():
             notation += "=" + self.pieceToNotation[self.promotionChoice if self.promotionChoice else 5]
         return notation
     
+    def getUciNotation(self):
+        """
+        Returns the move in UCI long algebraic notation (e.g. e2e4, e7e8q), as printed by other engines' perft.
+
+        Returns:
+            str: The move in UCI notation.
+        """
+        notation = self.getRankFile(self.startRow, self.startCol) + self.getRankFile(self.endRow, self.endCol)
+        if self.isPawnPromotion:
+            notation += "nbrq"[Bb.movePromotion(self.getCode()) - 2]
+        return notation
+
     def getRankFile(self, r, c):
         """
         Transcribe from row, column to rank, file (from code language to proper chess notation)
@@ -717,21 +635,3 @@ class Move():
             respective rank and file
         """
         return self.colsToFiles[c] + self.rowsToRanks[r]
-
-
-
-class CastleRight():
-    """
-    Checking castling availability including:
-
-    Attributes:
-        wks (bool): white king side
-        wqs (bool): white queen side
-        bks (bool): black king side
-        bqs (bool): black queen side
-    """
-    def __init__(self, wks, bks, wqs, bqs):
-        self.wks = wks
-        self.bks = bks
-        self.wqs = wqs
-        self.bqs = bqs
@@ -140,13 +140,14 @@ def main():
     """
     global USERNAME
     p.init()
+    SmartMoveFinder.startWorkers()  # start the AI processes now, while the menus are shown
     loadImages()
     screen = p.display.set_mode((WIDTH, HEIGHT + NAV_BAR_HEIGHT))
     clock = p.time.Clock()
 
     while True:
         mode, color = startingMenu(screen)
-        ai1_depth = ai2_depth = None
+        ai1_level = ai2_level = None
 
         if mode == "replay":
             while True:
@@ -158,23 +159,23 @@ def main():
             continue
 
         if mode == "pve":
-            ai_depth = difficultyMenu(screen, "Choose Difficulty for AI")
-            if ai_depth is None:
+            ai_level = difficultyMenu(screen, "Choose Difficulty for AI")
+            if ai_level is None:
                 continue
             playAsWhite = color
             playerOne = playAsWhite
             playerTwo = not playAsWhite
-            ai1_depth = ai_depth
+            ai1_level = ai_level
         elif mode == "pvp":
             playAsWhite = True
             playerOne = True
             playerTwo = True
         elif mode == "aivai":
-            ai1_depth = difficultyMenu(screen, "Choose Difficulty for White AI")
-            if ai1_depth is None:
+            ai1_level = difficultyMenu(screen, "Choose Difficulty for White AI")
+            if ai1_level is None:
                 continue
-            ai2_depth = difficultyMenu(screen, "Choose Difficulty for Black AI")
-            if ai2_depth is None:
+            ai2_level = difficultyMenu(screen, "Choose Difficulty for Black AI")
+            if ai2_level is None:
                 continue
             playAsWhite = True
             playerOne = False
@@ -183,12 +184,14 @@ def main():
         screen.fill(p.Color("white"))
         gs = CsE.GameState()
         gs.whiteToMove = True
+        SmartMoveFinder.newGame()
         validMoves = gs.getValidMoves()
         moveMade = False
         forwardMove = False
         drawOfferPending = False
         drawOfferedBy = None
         resignAccept = False
+        aiThinking = False
         moveLogPage = 0
         moveLog = []
         positions = [copy.deepcopy(gs.board)]
@@ -207,6 +210,7 @@ def main():
             move = None
             for e in p.event.get():
                 if e.type == p.QUIT:
+                    SmartMoveFinder.searchController.stop()
                     p.quit()
                     exit()
                 elif e.type == p.MOUSEBUTTONDOWN:
@@ -231,6 +235,7 @@ def main():
                         while waiting:
                             for e in p.event.get():
                                 if e.type == p.QUIT:
+                                    SmartMoveFinder.searchController.stop()
                                     p.quit()
                                     exit()
                                 elif e.type == p.MOUSEBUTTONDOWN:
@@ -283,6 +288,8 @@ def main():
                                     playerClicks = [squareSelected]
                 elif e.type == p.KEYDOWN:
                     if e.key == p.K_z:
+                        SmartMoveFinder.searchController.stop()
+                        aiThinking = False
                         gs.undoMove()
                         gs.undoMove()
                         forwardMove = False
@@ -307,6 +314,7 @@ def main():
                     while waiting:
                         for e in p.event.get():
                             if e.type == p.QUIT:
+                                SmartMoveFinder.searchController.stop()
                                 p.quit()
                                 exit()
                             elif e.type == p.MOUSEBUTTONDOWN:
@@ -329,6 +337,7 @@ def main():
                     while waiting:
                         for e in p.event.get():
                             if e.type == p.QUIT:
+                                SmartMoveFinder.searchController.stop()
                                 p.quit()
                                 exit()
                         fontBtn = p.font.Font(resource_path("font/DejaVuSans.ttf"), 16)
@@ -355,6 +364,7 @@ def main():
                         while waiting:
                             for e in p.event.get():
                                 if e.type == p.QUIT:
+                                    SmartMoveFinder.searchController.stop()
                                     p.quit()
                                     exit()
                             fontBtn = p.font.Font(resource_path("font/DejaVuSans.ttf"), 16)
@@ -406,13 +416,23 @@ def main():
 
             if not humanTurn:
                 if not playerOne and not playerTwo:
-                    SmartMoveFinder.DEPTH = ai1_depth if gs.whiteToMove else ai2_depth
+                    ai_level = ai1_level if gs.whiteToMove else ai2_level
                 else:
-                    SmartMoveFinder.DEPTH = ai1_depth
-                move = SmartMoveFinder.getMove(gs, validMoves)
-                gs.makeMove(move)
-                moveMade = True
-                forwardMove = True
+                    ai_level = ai1_level
+                limits = SmartMoveFinder.DIFFICULTY_LEVELS[ai_level]
+                # the search runs in the background, so the window keeps handling events while the AI thinks
+                if not aiThinking:
+                    if not SmartMoveFinder.searchController.ponderhit(gs):
+                        SmartMoveFinder.searchController.start(gs, limits)
+                    aiThinking = True
+                elif SmartMoveFinder.searchController.isDone():
+                    move = CsE.Move.fromCode(SmartMoveFinder.searchController.wait())
+                    aiThinking = False
+                    gs.makeMove(move)
+                    moveMade = True
+                    forwardMove = True
+                    if mode == "pve":
+                        SmartMoveFinder.searchController.ponder(gs, limits)  # think on the human's time
 
             if moveMade:
                 validMoves = gs.getValidMoves()
@@ -432,6 +452,7 @@ def main():
                     if len(moveLog) != 0:
                         moveLog.pop()
                 moveMade = False
+            clock.tick(MAX_FPS)  # leave the CPU to the search workers between frames
 
 def startingMenu(screen):
     """
@@ -514,6 +535,7 @@ def endingScreen(screen, result, gs, moveLog, positions):
         moveLog (list): List of move notations.
         positions (list): List of board positions.
     """
+    SmartMoveFinder.searchController.stop()  # the game is over, the AI stops thinking or pondering
     font_path = resource_path("font/DejaVuSans.ttf")
     font_display = p.font.Font(font_path, 36)
     font_menu = p.font.Font(font_path, 30)
@@ -551,7 +573,7 @@ def difficultyMenu(screen, text):
         text (str): The title text for the menu.
 
     Returns:
-        int or None: The selected AI depth, or None if user chooses to go back.
+        str or None: The selected key of SmartMoveFinder.DIFFICULTY_LEVELS, or None if user chooses to go back.
     """
     font_path = resource_path("font/DejaVuSans.ttf")
     font = p.font.Font(font_path, 36)
@@ -569,9 +591,9 @@ def difficultyMenu(screen, text):
         p.draw.rect(screen, p.Color("gray"), normalButton)
         p.draw.rect(screen, p.Color("gray"), hardButton)
         p.draw.rect(screen, p.Color("gray"), backButton)
-        screen.blit(fontBtn.render("Easy (Depth 2)", True, p.Color("black")), (easyButton.x + 68, easyButton.y + 10))
-        screen.blit(fontBtn.render("Normal (Depth 3)", True, p.Color("black")), (normalButton.x + 52, normalButton.y + 10))
-        screen.blit(fontBtn.render("Hard (Depth 4)", True, p.Color("black")), (hardButton.x + 68, hardButton.y + 10))
+        screen.blit(fontBtn.render("Easy (0.5 s)", True, p.Color("black")), (easyButton.x + 91, easyButton.y + 10))
+        screen.blit(fontBtn.render("Normal (1.5 s)", True, p.Color("black")), (normalButton.x + 74, normalButton.y + 10))
+        screen.blit(fontBtn.render("Hard (4 s)", True, p.Color("black")), (hardButton.x + 104, hardButton.y + 10))
         screen.blit(fontBtn.render("Back to Menu", True, p.Color("black")), (backButton.x + 78, backButton.y + 10))
 
         p.display.flip()
@@ -583,11 +605,11 @@ def difficultyMenu(screen, text):
             elif e.type == p.MOUSEBUTTONDOWN:
                 mouseX, mouseY = e.pos
                 if easyButton.collidepoint(mouseX, mouseY):
-                    return 2
+                    return "easy"
                 elif normalButton.collidepoint(mouseX, mouseY):
-                    return 3
+                    return "normal"
                 elif hardButton.collidepoint(mouseX, mouseY):
-                    return 4
+                    return "hard"
                 elif backButton.collidepoint(mouseX, mouseY):
                     return None  # Signal to go back to main menu
 
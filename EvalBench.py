@@ -0,0 +1,146 @@
+"""
+EvalBench.py
+
+Compares the evaluators of SmartMoveFinder (EVALUATOR): the handcrafted "classic" scoreBoard and the
+"nnue" network of the native core. First the evaluations per second, on every move of a few reference
+positions (make, evaluate, undo, less the make and undo alone), then a match between the two at a
+fixed depth from a few openings, each played with both colors. Runs headless in one process.
+
+Usage:
+    python EvalBench.py                          bootstrap network if none was written, depth 2
+    python EvalBench.py -d 3 --net my.nnue       deeper, with another network file
+    python EvalBench.py --games 0                evaluations per second only
+
+Author: Doan Quoc Kien
+"""
+import argparse
+import os
+import time
+import ChessEngine as CsE
+import SmartMoveFinder as Smf
+import Nnue
+import Perft
+
+EVALUATORS = ["classic", "nnue"]
+OPENINGS = [
+    ("start", CsE.START_FEN),
+    ("italian", "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3"),
+    ("sicilian", "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2"),
+    ("queen's gambit", "rnbqkbnr/ppp1pppp/8/3p4/2PP4/8/PP2PPPP/RNBQKBNR b KQkq - 0 2"),
+    ("middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"),
+]
+MAX_PLIES = 200  # a game still running after this many plies is scored as a draw
+
+def timeMoves(gs, repeats, evaluate):
+    """
+    Seconds to make, optionally evaluate, and undo every legal move of a position, repeats times.
+    """
+    moves = gs.getValidMoveCodes()
+    start = time.perf_counter()
+    for _ in range(repeats):
+        for move in moves:
+            gs.makeMove(move)
+            if evaluate:
+                Smf.scoreBoard(gs)
+            gs.undoMove()
+    return time.perf_counter() - start, repeats * len(moves)
+
+def benchEvaluations(repeats):
+    """
+    Print the evaluations per second of every evaluator.
+    """
+    positions = [CsE.GameState(fen) for _, fen, _, _ in Perft.REFERENCE_POSITIONS]
+    baseline = sum(timeMoves(gs, repeats, False)[0] for gs in positions)
+    for evaluator in EVALUATORS:
+        Smf.EVALUATOR = evaluator
+        results = [timeMoves(gs, repeats, True) for gs in positions]
+        seconds = sum(result[0] for result in results) - baseline
+        count = sum(result[1] for result in results)
+        print(f"  {evaluator:<8} {count / max(seconds, 1e-9):10.0f} evals/s  {1e6 * seconds / count:6.2f} us/eval")
+    # the network alone, on a position whose accumulator is already computed
+    gs = positions[0]
+    gs.position.evaluateNnue()
+    start = time.perf_counter()
+    for _ in range(100000):
+        gs.position.evaluateNnue()
+    seconds = time.perf_counter() - start
+    print(f"  {'network':<8} {100000 / seconds:10.0f} evals/s  {1e6 * seconds / 100000:6.2f} us/eval "
+          f"(hidden layers only, called from Python)")
+
+def searchMove(gs, evaluator, depth):
+    """
+    Fixed-depth search of the main process with an evaluator, from an empty transposition table.
+
+    Returns:
+        int: encoded move
+    """
+    Smf.EVALUATOR = evaluator
+    Smf.newGame()
+    Smf.transpositionTable.newSearch()
+    Smf.searchControl[Smf.STOP] = 0
+    repeated = {key: count for key, count in gs.positionCounts.items() if count >= 2}
+    result = Smf.lazySmpWorker((gs.snapshot(), repeated, 0, depth, None, None, None, Smf.transpositionTable.age))
+    Smf.searchControl[Smf.STOP] = 0
+    return result[2]
+
+def playGame(fen, white, black, depth):
+    """
+    Returns:
+        tuple: (result, plies, seconds used by each evaluator), result 1 if white won, 0 if black won, 0.5 for a draw
+    """
+    gs = CsE.GameState(fen)
+    seconds = {white: 0.0, black: 0.0}
+    for ply in range(MAX_PLIES):
+        moves = gs.getValidMoveCodes()
+        if gs.checkMate:
+            return (0 if gs.whiteToMove else 1), ply, seconds
+        if gs.draw:
+            return 0.5, ply, seconds
+        evaluator = white if gs.whiteToMove else black
+        start = time.perf_counter()
+        move = searchMove(gs, evaluator, depth) if len(moves) > 1 else moves[0]
+        seconds[evaluator] += time.perf_counter() - start
+        gs.makeMove(move)
+    return 0.5, MAX_PLIES, seconds
+
+def playMatch(depth, games):
+    """
+    Play the openings with both colors and print the games and the score of the network.
+    """
+    points = 0.0
+    played = 0
+    seconds = {evaluator: 0.0 for evaluator in EVALUATORS}
+    for name, fen in OPENINGS[:games]:
+        for white, black in (("nnue", "classic"), ("classic", "nnue")):
+            result, plies, used = playGame(fen, white, black, depth)
+            score = result if white == "nnue" else 1 - result
+            points += score
+            played += 1
+            for evaluator in EVALUATORS:
+                seconds[evaluator] += used[evaluator]
+            print(f"  {name:<16} {white:>7} - {black:<7} {result:3.1f}-{1 - result:3.1f}  {plies:3} plies")
+    if played:
+        print(f"  nnue scored {points:.1f}/{played} against classic  "
+              f"(search time nnue {seconds['nnue']:.1f}s, classic {seconds['classic']:.1f}s)")
+
+def main():
+    parser = argparse.ArgumentParser(description="Evaluations per second and playing strength of the evaluators.")
+    parser.add_argument("-d", "--depth", type=int, default=2, help="search depth in plies of the match")
+    parser.add_argument("--games", type=int, default=len(OPENINGS), help="openings to play, two games each")
+    parser.add_argument("--repeats", type=int, default=200, help="passes over the moves of each position")
+    parser.add_argument("--net", default=Nnue.NETWORK_FILE, help="network file")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.net):
+        Nnue.writeBootstrapNetwork(args.net)
+        print(f"wrote bootstrap network {args.net}")
+    Smf.useEvaluator("nnue", args.net)
+    import chesscore
+    print(f"{chesscore.NNUE_SIMD} kernel, {args.net}")
+    print("evaluations:")
+    benchEvaluations(args.repeats)
+    print(f"match, depth {args.depth}:")
+    playMatch(args.depth, args.games)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+"""
+Nnue.py
+
+Network files of the NNUE evaluation run by the native position core (chesscore, see setup.py):
+writing, loading and a bootstrap network to start from.
+
+The network is HalfKP 40960 -> 128 (per side) -> 32 -> 32 -> 1. Each side has one input per non-king
+piece, indexed by that side's king square, the piece (own or enemy pawn, knight, bishop, rook, queen) and
+its square, with the board flipped for black. A file holds, little-endian:
+    magic "DQKNNUE1", int32 features, L1, L2, L3, output scale,
+    int16 feature bias [L1], int16 feature weights [features][L1],
+    int32 hidden1 bias [L2], int8 hidden1 weights [L2][2 * L1],
+    int32 hidden2 bias [L3], int8 hidden2 weights [L3][L2],
+    int32 output bias, int8 output weights [L3].
+The hidden layers clamp their inputs to 0..127 and divide their sums by 64; the output times the scale
+over 1024 is the score for the side to move, in hundredths of a pawn.
+
+Write the bootstrap network with: python Nnue.py --bootstrap [path]
+
+Author: Doan Quoc Kien
+"""
+import os
+import sys
+import numpy as np
+import ChessEngine as CsE
+
+MAGIC = b"DQKNNUE1"
+FEATURES = 64 * 640
+L1 = 128
+L2 = 32
+L3 = 32
+WEIGHT_SCALE = 64  # hidden layer weights are scaled by this
+NETWORK_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "network.nnue")
+
+def available():
+    """
+    Returns:
+        bool: True if the positions in use can run the network (native core built and not disabled)
+    """
+    return hasattr(CsE.Position, "evaluateNnue")
+
+def loadNetwork(path=NETWORK_FILE):
+    """
+    Load a network file into the native core; every position evaluates with it from then on.
+    """
+    if not available():
+        raise RuntimeError("the NNUE evaluation needs the native position core (python setup.py build_ext --inplace)")
+    import chesscore
+    with open(path, "rb") as file:
+        chesscore.loadNetwork(file.read())
+
+def unloadNetwork():
+    if available():
+        import chesscore
+        chesscore.loadNetwork(None)
+
+def writeNetwork(path, network):
+    """
+    Parameters:
+        path (str): file to write
+        network (dict): featureBias, featureWeights, hidden1Bias, hidden1Weights, hidden2Bias, hidden2Weights,
+            outputBias, outputWeights (integer arrays of the shapes in the module docstring) and outputScale
+    """
+    header = np.array([FEATURES, L1, L2, L3, network["outputScale"]], dtype="<i4")
+    arrays = [
+        (network["featureBias"], "<i2", (L1,)),
+        (network["featureWeights"], "<i2", (FEATURES, L1)),
+        (network["hidden1Bias"], "<i4", (L2,)),
+        (network["hidden1Weights"], "i1", (L2, 2 * L1)),
+        (network["hidden2Bias"], "<i4", (L3,)),
+        (network["hidden2Weights"], "i1", (L3, L2)),
+        (network["outputBias"], "<i4", ()),
+        (network["outputWeights"], "i1", (L3,)),
+    ]
+    with open(path, "wb") as file:
+        file.write(MAGIC)
+        file.write(header.tobytes())
+        for values, dtype, shape in arrays:
+            values = np.asarray(values)
+            if values.shape != shape:
+                raise ValueError(f"expected shape {shape}, got {values.shape}")
+            file.write(values.astype(dtype).tobytes())
+
+def bootstrapNetwork(pieceSquareTable):
+    """
+    Network that scores the material and piece-square table of the classic evaluation
+    (SmartMoveFinder.pieceSquareScoreTable), a starting point for training. Per side, neurons 0-4
+    count the pawns, knights, bishops, rooks and queens and neurons 5-9 add up how much more than
+    the cheapest square of their kind they stand on, in units of 5 hundredths; the hidden layers pass
+    both sides through and the output takes their difference. Exact except for the king, which has
+    no input of its own, so its center bonus is left out.
+
+    Parameters:
+        pieceSquareTable (list): 27 rows of 64 scores in hundredths, white positive; must be the same for
+            black with the board flipped, as the two sides share the network weights
+    Returns:
+        dict: network for writeNetwork
+    """
+    table = np.asarray(pieceSquareTable, dtype=np.int64)
+    featureWeights = np.zeros((64, 10, 64, L1), dtype=np.int16)
+    outputWeights = np.zeros(L3, dtype=np.int8)
+    flipped = np.arange(64) ^ 56
+    for kind in range(5):
+        white = table[11 + kind]
+        if not np.array_equal(white, -table[21 + kind][flipped]):
+            raise ValueError("the piece-square table must be symmetric between white and black")
+        # cheapest square as count * weight (at most 10 pieces of a kind below the 127 clamp)
+        units = int(white.min()) // 5
+        while True:
+            factors = [(count, units // count) for count in range(1, 13)
+                       if units % count == 0 and units // count <= 127]
+            if factors:
+                break
+            units -= 1
+        count, weight = factors[0]
+        remainders = white - units * 5
+        if np.any(remainders % 5):
+            raise ValueError("piece-square scores must be multiples of 5 hundredths")
+        featureWeights[:, kind, :, kind] = count
+        featureWeights[:, kind, :, 5 + kind] = remainders // 5
+        outputWeights[kind] = weight
+        outputWeights[5 + kind] = 1
+    outputWeights[10:20] = -outputWeights[:10]
+
+    hidden1Weights = np.zeros((L2, 2 * L1), dtype=np.int8)
+    hidden2Weights = np.zeros((L3, L2), dtype=np.int8)
+    for neuron in range(10):
+        hidden1Weights[neuron, neuron] = WEIGHT_SCALE  # side to move
+        hidden1Weights[10 + neuron, L1 + neuron] = WEIGHT_SCALE  # other side
+    for neuron in range(20):
+        hidden2Weights[neuron, neuron] = WEIGHT_SCALE
+    return {
+        "featureBias": np.zeros(L1, dtype=np.int16),
+        "featureWeights": featureWeights.reshape(FEATURES, L1),
+        "hidden1Bias": np.zeros(L2, dtype=np.int32),
+        "hidden1Weights": hidden1Weights,
+        "hidden2Bias": np.zeros(L3, dtype=np.int32),
+        "hidden2Weights": hidden2Weights,
+        "outputBias": np.int32(0),
+        "outputWeights": outputWeights,
+        "outputScale": 5 * 1024,
+    }
+
+def writeBootstrapNetwork(path=NETWORK_FILE):
+    import SmartMoveFinder as Smf
+    writeNetwork(path, bootstrapNetwork(Smf.pieceSquareScoreTable()))
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2 or sys.argv[1] != "--bootstrap":
+        print("usage: python Nnue.py --bootstrap [path]")
+        sys.exit(1)
+    path = sys.argv[2] if len(sys.argv) > 2 else NETWORK_FILE
+    writeBootstrapNetwork(path)
+    print(f"wrote {path}")
@@ -0,0 +1,65 @@
+"""
+PawnHashTable.py
+
+Cache of pawn structure scores, indexed by the pawn-only Zobrist key of the position (Position.pawnKey).
+Pawns move in few of the positions the search visits, so nearly every evaluation finds its pawn score
+here instead of computing it again. Every search process has its own table.
+
+Author: Doan Quoc Kien
+"""
+EMPTY = -1  # keys are unsigned, so no position has this key
+
+class PawnHashTable():
+    """
+    Direct-mapped table: each key has one slot, and a new entry replaces whatever was there.
+    """
+    def __init__(self, entries=16384):
+        """
+        Parameters:
+            entries (int): number of slots, rounded down to a power of two
+        """
+        size = 1
+        while size * 2 <= entries:
+            size *= 2
+        self.mask = size - 1
+        self.keys = [EMPTY] * size
+        self.scores = [0.0] * size
+        self.probes = 0
+        self.hits = 0
+
+    def probe(self, key):
+        """
+        Parameters:
+            key (int): pawn Zobrist key
+        Returns:
+            float or None: the stored score, None if the key is not stored
+        """
+        self.probes += 1
+        index = key & self.mask
+        if self.keys[index] == key:
+            self.hits += 1
+            return self.scores[index]
+        return None
+
+    def store(self, key, score):
+        index = key & self.mask
+        self.keys[index] = key
+        self.scores[index] = score
+
+    def clear(self):
+        """
+        Empty the table and reset the counters.
+        """
+        self.keys = [EMPTY] * len(self.keys)
+        self.resetStats()
+
+    def resetStats(self):
+        self.probes = 0
+        self.hits = 0
+
+    def stats(self):
+        """
+        Returns:
+            dict: probes, hits and hit rate since the last resetStats
+        """
+        return {"probes": self.probes, "hits": self.hits, "hitRate": self.hits / max(self.probes, 1)}
@@ -0,0 +1,167 @@
+"""
+Perft.py
+
+Counts the leaf nodes of the legal move tree to a fixed depth (perft). The counts are compared against
+known totals for a set of reference positions, so this is both the correctness check and the
+throughput benchmark for the move generator. It runs headless, without pygame.
+
+Usage:
+    python Perft.py                       run every reference position to its default depth
+    python Perft.py --depth 5             start position to depth 5
+    python Perft.py --fen "<fen>" -d 3    any position
+    python Perft.py --divide -d 3         node count below every root move
+    python Perft.py --phases              time spent generating, making and undoing moves
+
+Author: Doan Quoc Kien
+"""
+import argparse
+import sys
+import time
+import ChessEngine as CsE
+
+"""
+Reference positions: name, FEN, depth run by default and the known totals per depth (from the
+Chess Programming Wiki perft results).
+"""
+REFERENCE_POSITIONS = [
+    ("start", CsE.START_FEN,
+     4, {1: 20, 2: 400, 3: 8902, 4: 197281, 5: 4865609}),
+    ("kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     3, {1: 48, 2: 2039, 3: 97862, 4: 4085603}),
+    ("en passant and pins", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     5, {1: 14, 2: 191, 3: 2812, 4: 43238, 5: 674624}),
+    ("castling and promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     3, {1: 6, 2: 264, 3: 9467, 4: 422333}),
+    ("promotion with check", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     3, {1: 44, 2: 1486, 3: 62379, 4: 2103487}),
+    ("middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     3, {1: 46, 2: 2079, 3: 89890, 4: 3894594}),
+    ("discovered en passant check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+     5, {1: 15, 2: 126, 3: 1440, 4: 9045, 5: 206379}),
+    ("castle through check", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+     3, {1: 44, 2: 1494, 3: 50509}),
+]
+
+def perft(gs, depth):
+    """
+    Count the leaf nodes of the legal move tree. The last ply is counted from the length of the
+    move list instead of being played (bulk counting).
+
+    Parameters:
+        gs (GameState): position to search from, left unchanged
+        depth (int): number of plies, at least 1
+    Returns:
+        int: number of leaf nodes
+    """
+    moves = gs.getLegalMoveCodes()
+    if depth == 1:
+        return len(moves)
+    nodes = 0
+    for move in moves:
+        gs.makeMove(move)
+        nodes += perft(gs, depth - 1)
+        gs.undoMove()
+    return nodes
+
+def perftPhases(gs, depth, phases):
+    """
+    Same count as perft, but adds the time spent in every phase of the move generator to phases.
+    The timer calls make this slower than perft, so the times are only meaningful relative to each other.
+
+    Parameters:
+        gs (GameState): position to search from, left unchanged
+        depth (int): number of plies, at least 1
+        phases (dict): seconds per phase ("generate", "make", "undo"), updated in place
+    Returns:
+        int: number of leaf nodes
+    """
+    clock = time.perf_counter
+    t = clock()
+    moves = gs.getLegalMoveCodes()
+    phases["generate"] += clock() - t
+    if depth == 1:
+        return len(moves)
+    nodes = 0
+    for move in moves:
+        t = clock()
+        gs.makeMove(move)
+        phases["make"] += clock() - t
+        nodes += perftPhases(gs, depth - 1, phases)
+        t = clock()
+        gs.undoMove()
+        phases["undo"] += clock() - t
+    return nodes
+
+def divide(gs, depth):
+    """
+    Perft split by root move, for finding the move where the count differs from another engine.
+
+    Parameters:
+        gs (GameState): position to search from, left unchanged
+        depth (int): number of plies, at least 1
+    Returns:
+        list: (move in UCI notation, leaf nodes below it) for every legal move
+    """
+    results = []
+    for move in gs.getLegalMoveCodes():
+        gs.makeMove(move)
+        nodes = perft(gs, depth - 1) if depth > 1 else 1
+        gs.undoMove()
+        results.append((CsE.Move.fromCode(move).getUciNotation(), nodes))
+    return results
+
+def runPosition(fen, depth, showDivide=False, showPhases=False, expected=None):
+    """
+    Run perft on one position and print the count, the speed and, if asked, the divide and phase breakdown.
+
+    Returns:
+        bool: False if expected was given and the count differs from it
+    """
+    gs = CsE.GameState(fen)
+    start = time.perf_counter()
+    if showDivide:
+        results = divide(gs, depth)
+        for notation, count in results:
+            print(f"  {notation}: {count}")
+        nodes = sum(count for _, count in results)
+    else:
+        nodes = perft(gs, depth)
+    elapsed = time.perf_counter() - start
+    status = ""
+    if expected is not None:
+        status = "ok " if nodes == expected else f"FAIL (expected {expected}) "
+    print(f"{status}depth {depth}: {nodes} nodes in {elapsed:.3f}s, {nodes / max(elapsed, 1e-9):,.0f} nodes/s")
+    if showPhases:
+        phases = {"generate": 0.0, "make": 0.0, "undo": 0.0}
+        perftPhases(gs, depth, phases)
+        total = sum(phases.values())
+        for phase, seconds in phases.items():
+            print(f"  {phase:<8} {seconds:8.3f}s {100 * seconds / max(total, 1e-9):5.1f}%")
+    return expected is None or nodes == expected
+
+def main():
+    parser = argparse.ArgumentParser(description="Move generator perft: node counts, divide and speed.")
+    parser.add_argument("--fen", help="position to run instead of the reference positions")
+    parser.add_argument("-d", "--depth", type=int, help="depth in plies")
+    parser.add_argument("--divide", action="store_true", help="print the node count below every root move")
+    parser.add_argument("--phases", action="store_true", help="time move generation, make and undo separately")
+    args = parser.parse_args()
+
+    print(f"backend: {CsE.Position.__module__}.{CsE.Position.__name__}")
+    if args.fen or args.depth:
+        fen = args.fen or CsE.START_FEN
+        expected = None
+        for _, referenceFen, _, totals in REFERENCE_POSITIONS:
+            if referenceFen.split()[:4] == fen.split()[:4]:
+                expected = totals.get(args.depth or 3)
+        print(fen)
+        passed = runPosition(fen, args.depth or 3, args.divide, args.phases, expected)
+    else:
+        passed = True
+        for name, fen, depth, totals in REFERENCE_POSITIONS:
+            print(f"{name}: {fen}")
+            passed = runPosition(fen, depth, args.divide, args.phases, totals[depth]) and passed
+    sys.exit(0 if passed else 1)
+
+if __name__ == "__main__":
+    main()
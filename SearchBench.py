@@ -0,0 +1,67 @@
+"""
+SearchBench.py
+
+Compares the parallel search modes of SmartMoveFinder (PARALLEL_SEARCH) on a fixed-depth search of a
+few reference positions: the move found, its line, nodes searched and time taken per move. The transposition
+table is cleared before every search, so every mode starts from the same state. Runs headless.
+
+Usage:
+    python SearchBench.py                        every mode, depth 2, one worker per CPU
+    python SearchBench.py -d 3 --workers 4       deeper, with a fixed number of workers
+    python SearchBench.py --modes map split      only some of the modes
+
+Author: Doan Quoc Kien
+"""
+import argparse
+import time
+import ChessEngine as CsE
+import SmartMoveFinder as Smf
+import Perft
+
+MODES = ["map", "split", "lazy"]
+BENCH_POSITIONS = [(name, fen) for name, fen, _, _ in Perft.REFERENCE_POSITIONS
+                   if name in ("start", "kiwipete", "promotion with check", "middlegame")]
+
+def runMode(mode, depth):
+    """
+    Search every bench position with one parallel mode and print a line per position.
+
+    Returns:
+        tuple: (total nodes, total seconds)
+    """
+    Smf.PARALLEL_SEARCH = mode
+    totalNodes = 0
+    totalTime = 0.0
+    for name, fen in BENCH_POSITIONS:
+        Smf.newGame()
+        gs = CsE.GameState(fen)
+        move = Smf.getMove(gs, gs.getValidMoves(), Smf.SearchLimits(depth=depth))
+        info = Smf.lastSearchInfo
+        totalNodes += info["nodes"]
+        totalTime += info["time"]
+        print(f"  {name:<22} {move.getUciNotation():<6} score {info['score']:8.2f} {info['nodes']:8} nodes "
+              f"{info['time']:7.2f}s  tt hits {100 * info['ttHitRate']:4.1f}%  pawn hits {100 * info['pawnHitRate']:4.1f}%")
+        print(f"  {'':<22} pv {' '.join(CsE.Move.fromCode(m).getUciNotation() for m in info['pv'])}")
+    return totalNodes, totalTime
+
+def main():
+    parser = argparse.ArgumentParser(description="Nodes and time per move of the parallel search modes.")
+    parser.add_argument("-d", "--depth", type=int, default=2, help="search depth in plies")
+    parser.add_argument("--workers", type=int, help="number of search workers, one per CPU by default")
+    parser.add_argument("--modes", nargs="+", choices=MODES, default=MODES, help="modes to compare")
+    args = parser.parse_args()
+
+    Smf.startWorkers(args.workers)
+    print(f"depth {args.depth}, {Smf.workerCount} workers")
+    totals = {}
+    for mode in args.modes:
+        print(f"{mode}:")
+        totals[mode] = runMode(mode, args.depth)
+    baseline = totals.get("map")
+    for mode, (nodes, seconds) in totals.items():
+        relative = f"  {nodes / max(baseline[0], 1):.2f}x nodes, {seconds / max(baseline[1], 1e-9):.2f}x time of map" if baseline else ""
+        print(f"{mode:<6} {nodes:9} nodes {seconds:8.2f}s  {nodes / len(BENCH_POSITIONS):9.0f} nodes/move{relative}")
+    Smf.stopWorkers()
+
+if __name__ == "__main__":
+    main()
@@ -7,8 +7,18 @@ Implements NegaMax and MinMax algorithms, board scoring, and helper functions fo
 Author: Doan Quoc Kien
 """
 import numpy as np
+import math
+import os
 import random
-from multiprocessing import Queue, Pool
+import time
+import atexit
+import threading
+import ChessEngine as CsE
+import Bitboard as Bb
+import TranspositionTable as Tt
+import PawnHashTable as Ph
+import Nnue
+from multiprocessing import Queue, Pool, shared_memory
 
 pieceScore = {
     1: 1.5,  # White pawn
@@ -80,11 +90,282 @@ piecePositionScores = {2: kightScore,
                        11: whitePawnScore,
                        21: blackPawnScore}
 
-CHECKMATE = 1000000
+CENTER_SQUARES = [(3, 3), (3, 4), (4, 3), (4, 4)]
+CENTER_SCORE = 1  # for any piece standing on a center square
+MOBILITY_SCORE = 0.05  # per pseudo-legal move
+PASSED_PAWN_SCORES = [0.1, 0.15, 0.25, 0.4, 0.65, 1.0]  # by rows advanced from the starting row
+ISOLATED_PAWN_PENALTY = 0.2  # no friendly pawn on an adjacent file
+BACKWARD_PAWN_PENALTY = 0.15  # no friendly pawn beside or behind on an adjacent file, and the square ahead is held by an enemy pawn
+PAWN_TABLE_ENTRIES = 16384
+
+def pieceSquareScoreTable():
+    """
+    Material, piece-square and center control scores of every piece code on every square, in hundredths
+    of a pawn from white's point of view, for the running total kept by the positions (Position.pieceSquareScore).
+
+    Returns:
+        list: 27 rows of 64 ints, indexed by piece code and square
+    """
+    table = [[0] * 64 for _ in range(27)]
+    for piece in (11, 12, 13, 14, 15, 16, 21, 22, 23, 24, 25, 26):
+        pieceType = piece % 10
+        sign = 1 if piece // 10 == 1 else -1
+        for row in range(8):
+            for col in range(8):
+                piecePositionScore = 0
+                if pieceType == 1:  # For pawns
+                    piecePositionScore = piecePositionScores[piece][row][col]
+                elif pieceType != 6:  # No position table for king, yet
+                    piecePositionScore = piecePositionScores[pieceType][row][col]
+                score = round(pieceScore[pieceType] * 100) + int(piecePositionScore) * 5
+                if (row, col) in CENTER_SQUARES:
+                    score += CENTER_SCORE * 100
+                table[piece][row * 8 + col] = sign * score
+    return table
+
+PIECE_SQUARE_TABLE = np.array(pieceSquareScoreTable())  # (27, 64), also used by scoreBoards
+CsE.setPieceSquareScores(PIECE_SQUARE_TABLE.tolist())
+
+CHECKMATE = 1000000  # score of a mate on the board at the root, a mate n plies away scores CHECKMATE - n
 DRAW = 0
 DEPTH = 2
+MAX_DEPTH = 64
+QUIESCENCE_CHECK_EVASIONS = True  # search every reply to a check in the quiescence search instead of standing pat
+DELTA_MARGIN = 3.0  # a capture that cannot bring the score within this of alpha is not searched
+MAX_PLY = 128
+MATE_BOUND = CHECKMATE - MAX_PLY  # scores at or beyond this are mates
+NULL_WINDOW = 0.01  # scores are kept to hundredths, so this is the smallest window that can fail high or low
+NULL_MOVE_MIN_DEPTH = 3
+NULL_MOVE_REDUCTION = 2
+LMR_MIN_DEPTH = 3  # late move reductions only this far from the horizon
+LMR_MIN_MOVES = 3  # and only after this many moves were searched at full depth
+FUTILITY_MARGIN = 3.0  # at depth 1, quiet moves are skipped if the static score is this far below alpha
+RAZOR_MARGIN = 3.0  # per ply of depth, at depth 1 and 2 a static score this far below alpha drops into quiescence
+ASPIRATION_MIN_DEPTH = 2  # iterations from this depth on search the root in a window around the previous score
+ASPIRATION_WINDOW = 0.5  # half width of the first aspiration window, doubled after every fail
+MAX_PV_LENGTH = 16
+
+TT_SIZE_MB = 16
+PARALLEL_SEARCH = "lazy"  # "lazy", "split" or "map", see findBestMove
+EVALUATOR = os.environ.get("CHESS_EVALUATOR", "classic")  # "classic" (handcrafted) or "nnue" (network), see setEvaluator
+NETWORK_FILE = Nnue.NETWORK_FILE
+
+"""
+Transposition table and search control words of this process. They are private until startWorkers
+moves them to a shared memory block that every search worker maps, so all workers read and write
+the same table.
+"""
+CONTROL_BYTES = 64
+STOP = 0  # searchControl index: nonzero tells every worker to abandon its search
+ALPHA = 1  # searchControl index: best root score found so far in the iteration, in hundredths (split search)
+transpositionTable = Tt.TranspositionTable(TT_SIZE_MB)
+searchControl = memoryview(bytearray(CONTROL_BYTES)).cast("q")
+sharedMemory = None
+ownsSharedMemory = False
+
+class SearchTimeout(Exception):
+    """
+    Raised inside the search when the deadline or node budget is reached, to unwind the unfinished iteration.
+    """
+
+class SearchLimits():
+    """
+    How long the AI may think about one move. Either a fixed time per move (moveTime) or a game clock
+    (whiteTime/blackTime with increments), optionally capped by a node budget and a maximum depth.
+    Times are in seconds, None means no limit of that kind.
+    """
+    def __init__(self, moveTime=None, whiteTime=None, blackTime=None, whiteIncrement=0, blackIncrement=0,
+                 movesToGo=None, nodes=None, depth=MAX_DEPTH):
+        self.moveTime = moveTime
+        self.whiteTime = whiteTime
+        self.blackTime = blackTime
+        self.whiteIncrement = whiteIncrement
+        self.blackIncrement = blackIncrement
+        self.movesToGo = movesToGo
+        self.nodes = nodes
+        self.depth = depth
+
+    def allocateTime(self, whiteToMove):
+        """
+        Split the thinking time into a soft limit, after which no new iteration is started, and a hard
+        limit, at which the running iteration is abandoned.
+
+        Parameters:
+            whiteToMove (bool): side the AI plays
+        Returns:
+            tuple: (soft, hard) in seconds, (None, None) if the search is not limited by time
+        """
+        if self.moveTime is not None:
+            return self.moveTime / 2, self.moveTime
+        remaining = self.whiteTime if whiteToMove else self.blackTime
+        if remaining is None:
+            return None, None
+        increment = self.whiteIncrement if whiteToMove else self.blackIncrement
+        overhead = 0.05  # keep a margin for starting the workers and sending the move back
+        usable = max(remaining - overhead, 0.01)
+        soft = min(usable / (self.movesToGo or 30) + increment * 0.75, usable)
+        hard = min(soft * 3, usable / 2 + increment)
+        return soft, max(hard, soft)
+
+"""
+Difficulty levels offered in the menu, as the time the AI may think per move. Easy is also held to the
+old easy depth, so a fast machine does not make it stronger.
+"""
+DIFFICULTY_LEVELS = {
+    "easy": SearchLimits(moveTime=0.5, depth=2),
+    "normal": SearchLimits(moveTime=1.5),
+    "hard": SearchLimits(moveTime=4.0),
+}
+
+def setHashSize(sizeMB):
+    """
+    Replace the transposition table with an empty one of the given size in megabytes.
+    Running search workers are stopped, so the next search starts them with the new size.
+    """
+    global TT_SIZE_MB, transpositionTable
+    stopWorkers()
+    TT_SIZE_MB = sizeMB
+    transpositionTable.release()
+    transpositionTable = Tt.TranspositionTable(sizeMB)
+
+def setEvaluator(name, networkFile=None):
+    """
+    Choose what scoreBoard returns: "classic", the handcrafted evaluation, or "nnue", the network of
+    networkFile (NETWORK_FILE if None) run by the native core. Running search workers are stopped, so the
+    next search starts them with the new evaluator.
+    """
+    stopWorkers()
+    useEvaluator(name, networkFile or NETWORK_FILE)
+
+def useEvaluator(name, networkFile):
+    global EVALUATOR, NETWORK_FILE
+    if name not in ("classic", "nnue"):
+        raise ValueError(f"unknown evaluator {name}")
+    if name == "nnue":
+        Nnue.loadNetwork(networkFile)
+        NETWORK_FILE = networkFile
+    EVALUATOR = name
+
+def openSharedMemory(name=None):
+    """
+    Move the transposition table and search control words of this process to shared memory: a new,
+    empty block if name is None, otherwise the block of that name created by the main process.
+    """
+    global sharedMemory, ownsSharedMemory, transpositionTable, searchControl
+    # views into a block inherited from the main process (fork) must go before that block is dropped
+    transpositionTable.release()
+    searchControl.release()
+    if name is None:
+        sharedMemory = shared_memory.SharedMemory(create=True, size=CONTROL_BYTES + Tt.tableBytes(TT_SIZE_MB))
+        ownsSharedMemory = True
+    else:
+        sharedMemory = shared_memory.SharedMemory(name=name)
+    searchControl = sharedMemory.buf[:CONTROL_BYTES].cast("q")
+    transpositionTable = Tt.TranspositionTable(TT_SIZE_MB, sharedMemory.buf[CONTROL_BYTES:])
+
+def closeSharedMemory():
+    """
+    Go back to a private table and control words and free the shared block created by openSharedMemory.
+    """
+    global sharedMemory, ownsSharedMemory, transpositionTable, searchControl
+    if sharedMemory is None:
+        return
+    transpositionTable.release()
+    searchControl.release()
+    sharedMemory.close()
+    if ownsSharedMemory:
+        sharedMemory.unlink()
+    sharedMemory = None
+    ownsSharedMemory = False
+    transpositionTable = Tt.TranspositionTable(TT_SIZE_MB)
+    searchControl = memoryview(bytearray(CONTROL_BYTES)).cast("q")
+
+"""
+Search worker pool, started once and kept for every later move (see startWorkers).
+"""
+workerPool = None
+workerCount = 0
+
+def initWorker(sizeMB, sharedMemoryName, evaluator, networkFile):
+    """
+    Runs once in every new worker process: map the shared table of the main process and load its evaluator.
+    """
+    global TT_SIZE_MB
+    TT_SIZE_MB = sizeMB
+    openSharedMemory(sharedMemoryName)
+    useEvaluator(evaluator, networkFile)
+
+def startWorkers(processes=None):
+    """
+    Start the search worker pool if it is not running yet. Called at app start, so the workers are
+    ready (interpreters started, modules imported) by the time the AI has to move.
+
+    Parameters:
+        processes (int): number of workers, one per CPU if None
+    Returns:
+        multiprocessing.Pool: the running pool
+    """
+    global workerPool, workerCount
+    if workerPool is None:
+        if sharedMemory is None:
+            openSharedMemory()
+        workerCount = processes or os.cpu_count() or 1
+        workerPool = Pool(workerCount, initializer=initWorker, initargs=(TT_SIZE_MB, sharedMemory.name, EVALUATOR, NETWORK_FILE))
+    return workerPool
+
+def stopWorkers():
+    """
+    Stop the search worker pool and free the shared table.
+    """
+    global workerPool
+    if workerPool is not None:
+        workerPool.terminate()
+        workerPool.join()
+        workerPool = None
+    closeSharedMemory()
+
+atexit.register(stopWorkers)
+
+if EVALUATOR != "classic":
+    useEvaluator(EVALUATOR, NETWORK_FILE)  # CHESS_EVALUATOR=nnue loads the network at startup
+
+def newGame():
+    """
+    Forget everything learned about the previous game. The table is shared, so this also clears it for the workers.
+    """
+    transpositionTable.clear()
+
+"""
+Summary of the last search done by findBestMove: depth completed, score, nodes, seconds, the
+transposition and pawn table hit rates and the expected line (pv, encoded moves starting with the move played).
+"""
+lastSearchInfo = {}
+searchNodes = 0
+searchDeadline = None
+searchNodeLimit = None
+searchStoppable = True  # False while depth 1 is searched, which always completes so there is a move to play
+
+"""
+Move ordering memory of this process, kept between the tasks of one search (see newSearchOrdering):
+two killer moves per ply (quiet moves that caused a beta cutoff at that ply) and a butterfly history
+table (index color * 4096 + start * 64 + end) counting how well each quiet move has done.
+"""
+killerMoves = [[0, 0] for _ in range(MAX_PLY)]
+historyScores = [0] * (2 * 4096)
+orderingAge = -1
 
-transpositionTable = {}
+def newSearchOrdering(ttAge):
+    """
+    Reset the killer moves and age the history table when a task of a new search arrives.
+    """
+    global orderingAge
+    if ttAge == orderingAge:
+        return
+    orderingAge = ttAge
+    for killers in killerMoves:
+        killers[0] = killers[1] = 0
+    for i in range(len(historyScores)):
+        historyScores[i] >>= 2
 
 def findRandomMove(validMoves):
     """
@@ -105,79 +386,570 @@ def parallelEvaluateMove(args):
     Evaluates a move in parallel for multiprocessing.
 
     Parameters:
-        args (tuple): (gs, move, depth, alpha, beta, turnMultiplier)
+        args (tuple): (snapshot, repeated, move, depth, alpha, beta, turnMultiplier, deadline, nodeLimit, ttAge,
+            sharedAlpha), where snapshot is GameState.snapshot() and repeated the positions already seen twice,
+            so the worker still sees threefold repetitions without receiving the whole game history. deadline
+            is a time.monotonic() value and nodeLimit a node count, either None for no limit. Depth 1 ignores
+            searchControl[STOP]. ttAge is the transposition table age of the search. With sharedAlpha, alpha
+            is raised to the best root score
+            published in searchControl[ALPHA] by the moves searched before, and a better score is published
 
     Returns:
-        tuple: (score (float), move)
+        tuple: (score (float), move, nodes, ttProbes, ttHits, exact, pawnProbes, pawnHits), score is None if
+            the search ran out of time or nodes. exact is False if the move failed low against a published
+            alpha, the score is then only an upper bound
     """
-    gs, move, depth, alpha, beta, turnMultiplier = args
+    global searchDeadline, searchNodeLimit, searchNodes, searchStoppable
+    snapshot, repeated, move, depth, alpha, beta, turnMultiplier, deadline, nodeLimit, ttAge, sharedAlpha = args
+    searchStoppable = depth > 1  # the first iteration of findBestMove always completes
+    searchAlpha = max(alpha, searchControl[ALPHA] / 100) if sharedAlpha else alpha
+    searchDeadline = deadline
+    searchNodeLimit = nodeLimit
+    searchNodes = 0
+    transpositionTable.age = ttAge
+    transpositionTable.resetStats()
+    pawnTable.resetStats()
+    newSearchOrdering(ttAge)
+    gs = CsE.GameState.fromSnapshot(snapshot, repeated)
     gs.makeMove(move)
-    nextMoves = gs.getValidMoves()
-    score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -alpha, -turnMultiplier)
-    gs.undoMove()
-    return score, move
+    nextMoves = gs.getLegalMoveCodes()
+    try:
+        if searchAlpha > alpha:
+            # scout with a null window first, only a move that beats the best so far needs its exact score
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -searchAlpha - NULL_WINDOW, -searchAlpha, -turnMultiplier)
+            if score > searchAlpha:
+                score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -searchAlpha, -turnMultiplier)
+        else:
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -searchAlpha, -turnMultiplier)
+    except SearchTimeout:
+        score = None
+    exact = score is not None and (score > searchAlpha or searchAlpha == alpha)
+    if sharedAlpha and exact:
+        # rounded down, so the published bound never exceeds a real score. Two workers can race here,
+        # the loser only leaves a lower alpha behind, which costs pruning but not correctness
+        published = math.floor(score * 100)
+        if published > searchControl[ALPHA]:
+            searchControl[ALPHA] = published
+    return (score, move, searchNodes, transpositionTable.probes, transpositionTable.hits, exact,
+            pawnTable.probes, pawnTable.hits)
 
-def findBestMove(gs, validMoves, returnQueue):
+def searchRoot(gs, rootMoves, depth, turnMultiplier, alpha=-CHECKMATE, beta=CHECKMATE):
     """
-    Finds the best move using NegaMax with alpha-beta pruning and multiprocessing.
+    Search all root moves to the given depth (principal variation search): the first move with the
+    window, every later one with a null window just above the best score, and again with the full
+    window only if it beats it.
 
     Parameters:
         gs (GameState): Current game state.
-        validMoves (list): List of valid moves.
+        rootMoves (list): Moves to search (encoded ints), in the order to search them.
+        depth (int): Search depth, at least 1.
+        turnMultiplier (int): 1 for white, -1 for black.
+        alpha, beta (float): Root window.
+
+    Returns:
+        tuple: (best score, the root moves with the best one moved to the front). A score at or below alpha
+            or at or above beta is only a bound
+    Raises:
+        SearchTimeout: the search was stopped before the iteration was complete
+    """
+    bestScore = -CHECKMATE
+    bestIndex = 0
+    for i, move in enumerate(rootMoves):
+        windowAlpha = max(alpha, bestScore)
+        gs.makeMove(move)
+        nextMoves = gs.getLegalMoveCodes()
+        if i == 0:
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -windowAlpha, -turnMultiplier)
+        else:
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -windowAlpha - NULL_WINDOW, -windowAlpha, -turnMultiplier)
+            if windowAlpha < score < beta:
+                score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -windowAlpha, -turnMultiplier)
+        gs.undoMove()
+        if score > bestScore:
+            bestScore = score
+            bestIndex = i
+            if score >= beta:
+                break
+    return bestScore, [rootMoves[bestIndex]] + rootMoves[:bestIndex] + rootMoves[bestIndex + 1:]
+
+def aspirationWindows(previousScore, depth):
+    """
+    Root windows to try one after the other for an iteration: a narrow one around the score of the previous
+    iteration, widened on the side that failed, up to the full window.
+
+    Parameters:
+        previousScore (float): Score of the previous iteration, None if there was none.
+        depth (int): Depth of the iteration.
+
+    Returns:
+        generator: (alpha, beta) windows. Send it the score of the last window to get the next one
+    """
+    if previousScore is None or depth < ASPIRATION_MIN_DEPTH or abs(previousScore) >= MATE_BOUND:
+        yield -CHECKMATE, CHECKMATE
+        return
+    delta = ASPIRATION_WINDOW
+    alpha = previousScore - delta
+    beta = previousScore + delta
+    while True:
+        score = yield alpha, beta
+        delta *= 2
+        if score <= alpha:
+            alpha = max(previousScore - delta, -CHECKMATE)
+        elif score >= beta:
+            beta = min(previousScore + delta, CHECKMATE)
+        else:
+            return
+
+def isExactScore(score, alpha, beta):
+    """
+    True if a score searched with the window (alpha, beta) is exact: inside the window, or at a side of it
+    that cannot be widened any further.
+    """
+    return alpha < score < beta or (score <= alpha and alpha <= -CHECKMATE) or (score >= beta and beta >= CHECKMATE)
+
+def searchRootAspiration(gs, rootMoves, depth, turnMultiplier, previousScore):
+    """
+    searchRoot with aspiration windows (see aspirationWindows), repeated until the score is exact.
+
+    Returns:
+        tuple: (best score, the root moves with the best one moved to the front)
+    """
+    windows = aspirationWindows(previousScore, depth)
+    alpha, beta = next(windows)
+    while True:
+        score, rootMoves = searchRoot(gs, rootMoves, depth, turnMultiplier, alpha, beta)
+        if isExactScore(score, alpha, beta):
+            return score, rootMoves
+        alpha, beta = windows.send(score)
+
+def getPrincipalVariation(gs, firstMove, maxLength=MAX_PV_LENGTH):
+    """
+    The line the search expects: firstMove, then the best moves stored in the transposition table, as far
+    as they are legal and do not repeat a position.
+
+    Parameters:
+        gs (GameState): Position the search started from, left unchanged.
+        firstMove (int): Move chosen by the search.
+        maxLength (int): Longest line returned.
+
+    Returns:
+        list: encoded moves
+    """
+    pv = [firstMove]
+    gs.makeMove(firstMove)
+    seen = {gs.getBoardHash()}
+    while len(pv) < maxLength:
+        entry = transpositionTable.probe(gs.getBoardHash())
+        if entry is None or entry[3] not in gs.getLegalMoveCodes():
+            break
+        gs.makeMove(entry[3])
+        pv.append(entry[3])
+        if gs.getBoardHash() in seen:
+            break
+        seen.add(gs.getBoardHash())
+    for _ in pv:
+        gs.undoMove()
+    return pv
+
+def lazySmpWorker(args):
+    """
+    One worker of the Lazy SMP search: an iterative deepening search of the whole tree, sharing the
+    transposition table with the other workers. Worker 0 is the main worker. It alone applies the soft
+    time limit, always completes depth 1, and stops the others when it is done. Helpers on odd indices
+    start one ply deeper and every helper searches the root moves in a rotated order, so the workers
+    spread over different parts of the tree and fill the table for each other.
+
+    Parameters:
+        args (tuple): (snapshot, repeated, index, maxDepth, softDeadline, deadline, nodeLimit, ttAge), deadlines
+            as time.monotonic() values, nodeLimit per worker, any of the three None for no limit
+
+    Returns:
+        tuple: (depth, score, move, nodes, ttProbes, ttHits, pawnProbes, pawnHits) for the last completed
+            iteration, depth 0 if none
+    """
+    global searchDeadline, searchNodeLimit, searchNodes, searchStoppable
+    snapshot, repeated, index, maxDepth, softDeadline, deadline, nodeLimit, ttAge = args
+    searchNodes = 0
+    transpositionTable.age = ttAge
+    transpositionTable.resetStats()
+    pawnTable.resetStats()
+    newSearchOrdering(ttAge)
+    gs = CsE.GameState.fromSnapshot(snapshot, repeated)
+    rootMoves = gs.getLegalMoveCodes()
+    turnMultiplier = 1 if gs.whiteToMove else -1
+    if index:
+        shift = index % len(rootMoves)
+        rootMoves = rootMoves[shift:] + rootMoves[:shift]
+    completed = (0, None, rootMoves[0])
+    for depth in range(1 + index % 2, maxDepth + 1):
+        # depth 1 of the main worker runs without limits and cannot be stopped, so there is always a move to play
+        unlimited = index == 0 and depth == 1
+        searchDeadline = None if unlimited else deadline
+        searchNodeLimit = None if unlimited else nodeLimit
+        searchStoppable = not unlimited
+        try:
+            score, rootMoves = searchRootAspiration(gs, rootMoves, depth, turnMultiplier, completed[1])
+        except SearchTimeout:
+            break
+        completed = (depth, score, rootMoves[0])
+        if index == 0:
+            if abs(score) >= MATE_BOUND or len(rootMoves) == 1:
+                break
+            if softDeadline is not None and time.monotonic() >= softDeadline:
+                break
+            if nodeLimit is not None and searchNodes >= nodeLimit:
+                break
+    if index == 0:
+        searchControl[STOP] = 1
+    return completed + (searchNodes, transpositionTable.probes, transpositionTable.hits, pawnTable.probes, pawnTable.hits)
+
+def findBestMove(gs, validMoves, returnQueue, limits=None):
+    """
+    Finds the best move using iterative deepening NegaMax with alpha-beta pruning, spread over the
+    search worker pool in one of three ways (PARALLEL_SEARCH):
+        "lazy": every worker searches the whole tree, sharing the transposition table (lazySmpWorker).
+            The move comes from the worker that completed the deepest iteration.
+        "split": every iteration searches each root move as its own task. The best move of the previous
+            iteration is searched first and alone, then the others in parallel, each starting from the best
+            score published so far (Young Brothers Wait at the root).
+        "map": as "split", but all root moves at once with the full window. Kept as the baseline for SearchBench.
+    An iteration cut short by the time or node budget, or by searchControl[STOP], is thrown away, so the
+    move returned always comes from a completed iteration. Depth 1 is always completed. searchControl[STOP]
+    must be cleared before the call (see SearchController).
+
+    Parameters:
+        gs (GameState): Current game state.
+        validMoves (list): List of valid moves (encoded ints).
         returnQueue (multiprocessing.Queue): Queue to return the best move.
+        limits (SearchLimits): Thinking budget, a fixed depth of DEPTH if None.
 
     Returns:
         None: The best move is put into returnQueue.
     """
-    with Pool() as pool:
-        results = pool.map(parallelEvaluateMove, [(gs, move, DEPTH, -CHECKMATE, CHECKMATE, 1 if gs.whiteToMove else -1) for move in validMoves])
-    global nextMove
-    nextMove = max(results, key=lambda x: x[0])[1]
+    global nextMove, lastSearchInfo
+    startTime = time.monotonic()
+    if limits is None:
+        limits = SearchLimits(depth=DEPTH)
+    soft, hard = limits.allocateTime(gs.whiteToMove)
+    snapshot = gs.snapshot()
+    repeated = {key: count for key, count in gs.positionCounts.items() if count >= 2}
+    pool = startWorkers()
+    transpositionTable.newSearch()
+    maxDepth = max(limits.depth, 1)
+    if PARALLEL_SEARCH == "lazy":
+        softDeadline = None if soft is None else startTime + soft
+        deadline = None if hard is None else startTime + hard
+        nodeLimit = None if limits.nodes is None else max(limits.nodes // workerCount, 1)
+        results = pool.map(lazySmpWorker, [(snapshot, repeated, index, maxDepth, softDeadline, deadline, nodeLimit,
+                                            transpositionTable.age) for index in range(workerCount)])
+        # deepest completed iteration wins, the main worker on a tie
+        depth, bestScore, nextMove = max(results, key=lambda x: x[0])[:3]
+        totalNodes = sum(result[3] for result in results)
+        ttProbes = sum(result[4] for result in results)
+        ttHits = sum(result[5] for result in results)
+        pawnProbes = sum(result[6] for result in results)
+        pawnHits = sum(result[7] for result in results)
+        lastSearchInfo = {"depth": depth, "score": bestScore}
+    else:
+        turnMultiplier = 1 if gs.whiteToMove else -1
+        rootMoves = list(validMoves)
+        nextMove = rootMoves[0]
+        totalNodes = ttProbes = ttHits = pawnProbes = pawnHits = 0
+        lastSearchInfo = {"depth": 0, "score": None}
+        sharedAlpha = PARALLEL_SEARCH == "split"
+        for depth in range(1, maxDepth + 1):
+            deadline = None if hard is None or depth == 1 else startTime + hard
+            nodeLimit = None if limits.nodes is None or depth == 1 else max((limits.nodes - totalNodes) // len(rootMoves), 1)
+            tasks = [(snapshot, repeated, move, depth, -CHECKMATE, CHECKMATE, turnMultiplier, deadline, nodeLimit,
+                      transpositionTable.age, sharedAlpha) for move in rootMoves]
+            if sharedAlpha:
+                # the first move alone, in aspiration windows around the previous score until it is exact
+                windows = aspirationWindows(lastSearchInfo["score"], depth)
+                alpha, beta = next(windows)
+                while True:
+                    searchControl[ALPHA] = -CHECKMATE * 100
+                    first = pool.apply(parallelEvaluateMove, (tasks[0][:4] + (alpha, beta) + tasks[0][6:],))
+                    if first[0] is None or isExactScore(first[0], alpha, beta):
+                        break
+                    totalNodes += first[2]
+                    ttProbes += first[3]
+                    ttHits += first[4]
+                    pawnProbes += first[6]
+                    pawnHits += first[7]
+                    alpha, beta = windows.send(first[0])
+                results = [first]
+                if first[0] is not None and len(tasks) > 1:
+                    results += pool.map(parallelEvaluateMove, tasks[1:])
+            else:
+                results = pool.map(parallelEvaluateMove, tasks)
+            totalNodes += sum(result[2] for result in results)
+            ttProbes += sum(result[3] for result in results)
+            ttHits += sum(result[4] for result in results)
+            pawnProbes += sum(result[6] for result in results)
+            pawnHits += sum(result[7] for result in results)
+            if len(results) < len(tasks) or any(result[0] is None for result in results):
+                break
+            # stable sort, so equal scores keep the order of the previous iteration. A move that failed low
+            # against the published alpha only has an upper bound and loses a tie with an exact score
+            results.sort(key=lambda x: (x[0], x[5]), reverse=True)
+            rootMoves = [result[1] for result in results]
+            nextMove = rootMoves[0]
+            bestScore = results[0][0]
+            lastSearchInfo = {"depth": depth, "score": bestScore}
+            if abs(bestScore) >= MATE_BOUND or len(rootMoves) == 1:
+                break
+            if soft is not None and time.monotonic() - startTime >= soft:
+                break
+            if limits.nodes is not None and totalNodes >= limits.nodes:
+                break
+    lastSearchInfo["nodes"] = totalNodes
+    lastSearchInfo["time"] = time.monotonic() - startTime
+    lastSearchInfo["ttHitRate"] = ttHits / max(ttProbes, 1)
+    lastSearchInfo["pawnHitRate"] = pawnHits / max(pawnProbes, 1)
+    lastSearchInfo["pv"] = getPrincipalVariation(CsE.GameState.fromSnapshot(snapshot, repeated), nextMove)
     returnQueue.put(nextMove)
 
-def findMoveNegaMaxAlphaBeta(gs, validMoves, depth, alpha, beta, turnMultiplier):
+def countNode():
     """
-    Recursively searches for the best move using NegaMax with alpha-beta pruning.
+    Count a search node and stop the search if it was told to or is out of time or nodes.
+
+    Raises:
+        SearchTimeout: the deadline or node budget of the search was reached
+    """
+    global searchNodes
+    searchNodes += 1
+    # nodes are expensive here (every one orders and scores its moves), so the clock is read at every node
+    if searchControl[STOP] and searchStoppable:
+        raise SearchTimeout()
+    if searchDeadline is not None and time.monotonic() >= searchDeadline:
+        raise SearchTimeout()
+    if searchNodeLimit is not None and searchNodes >= searchNodeLimit:
+        raise SearchTimeout()
+
+def mvvLva(move):
+    """
+    Most valuable victim, least valuable attacker: capturing a bigger piece first, with a smaller one on a tie.
+
+    Parameters:
+        move (int): encoded move
+    Returns:
+        float: ordering key, higher first
+    """
+    return pieceScore.get(Bb.moveCaptured(move) % 10, 0) * 10 - pieceScore[Bb.movePiece(move) % 10]
+
+def quiescence(gs, validMoves, alpha, beta, turnMultiplier):
+    """
+    Search captures and queen promotions from a horizon node until the position is quiet, so the
+    score is never taken in the middle of an exchange. The side to move may stand pat (keep the
+    static score) unless it is in check, where all replies are searched (QUIESCENCE_CHECK_EVASIONS).
 
     Parameters:
         gs (GameState): Current game state.
-        validMoves (list): List of valid moves.
+        validMoves (list): List of valid moves (encoded ints).
+        alpha (float): Alpha value for pruning.
+        beta (float): Beta value for pruning.
+        turnMultiplier (int): 1 for white, -1 for black.
+
+    Returns:
+        float: Evaluation score of the position.
+    Raises:
+        SearchTimeout: the deadline or node budget of the search was reached
+    """
+    countNode()
+    terminal = scoreTerminal(gs, validMoves)
+    if terminal is not None:
+        return turnMultiplier * terminal
+
+    if QUIESCENCE_CHECK_EVASIONS and gs.inCheck():
+        standPat = -CHECKMATE
+        moves = validMoves
+    else:
+        standPat = turnMultiplier * scoreBoard(gs)
+        if standPat >= beta:
+            return standPat
+        if standPat > alpha:
+            alpha = standPat
+        moves = []
+        for move in validMoves:
+            queening = move >> 12 & 15 == 15  # promotion flag and queen
+            captured = Bb.moveCaptured(move)
+            if not captured and not queening:
+                continue
+            # delta pruning: even winning the piece for free would not reach alpha
+            gain = pieceScore[captured % 10] if captured else 0
+            if queening:
+                gain += pieceScore[5] - pieceScore[1]
+            if standPat + gain + DELTA_MARGIN <= alpha:
+                continue
+            moves.append(move)
+    moves.sort(key=mvvLva, reverse=True)
+
+    maxScore = standPat
+    for move in moves:
+        gs.makeMove(move)
+        nextMoves = gs.getLegalMoveCodes()
+        score = -quiescence(gs, nextMoves, -beta, -alpha, -turnMultiplier)
+        gs.undoMove()
+        if score > maxScore:
+            maxScore = score
+            if score > alpha:
+                alpha = score
+            if alpha >= beta:
+                break
+    return maxScore
+
+def findMoveNegaMaxAlphaBeta(gs, validMoves, depth, alpha, beta, turnMultiplier, allowNull=True):
+    """
+    Recursively searches for the best move using NegaMax with alpha-beta pruning. Every legal move is
+    searched, the selectivity comes from pruning that is undone or bounded when it matters:
+        razoring: at depth 1 and 2, a static score far below alpha drops into quiescence, and the node is
+            only cut if quiescence confirms it cannot reach alpha
+        null move: if passing the turn still fails high on a reduced search, so will a real move. Not
+            tried in check, twice in a row, or without a piece other than pawns (zugzwang)
+        futility: at depth 1, quiet moves that give no check are skipped when the static score is too
+            far below alpha for them to matter
+        late move reductions: late quiet moves are searched shallower first, and again at full depth if
+            they beat alpha
+    Moves after the first are searched with a null window around alpha (principal variation search)
+    and only searched again with the full window if they beat it.
+
+    Parameters:
+        gs (GameState): Current game state.
+        validMoves (list): List of valid moves (encoded ints).
         depth (int): Search depth.
         alpha (float): Alpha value for pruning.
         beta (float): Beta value for pruning.
         turnMultiplier (int): 1 for white, -1 for black.
+        allowNull (bool): False right after a null move.
 
     Returns:
         float: Evaluation score of the position.
+    Raises:
+        SearchTimeout: the deadline or node budget of the search was reached
     """
-    global nextMove
-    boardHash = hash(str(gs.board))
-    if boardHash in transpositionTable and transpositionTable[boardHash][0] >= depth:
-        return transpositionTable[boardHash][1]
+    countNode()
+    ply = gs.position.ply
+    boardHash = gs.getBoardHash()
+    entry = transpositionTable.probe(boardHash)
+    ttMove = 0
+    if entry is not None:
+        ttScore, ttDepth, bound, ttMove = entry
+        ttScore = scoreFromTt(ttScore, ply)
+        if ttDepth >= depth and (bound == Tt.EXACT or (bound == Tt.LOWER and ttScore >= beta) or (bound == Tt.UPPER and ttScore <= alpha)):
+            return ttScore
 
-    if depth == 0:
-        return turnMultiplier * scoreBoard(gs)
-    
+    if depth <= 0:
+        return quiescence(gs, validMoves, alpha, beta, turnMultiplier)
+    terminal = scoreTerminal(gs, validMoves)
+    if terminal is not None:
+        return turnMultiplier * terminal
+
+    inCheck = gs.inCheck()
+    staticScore = None
+    if not inCheck:
+        if depth <= 2 or (allowNull and depth >= NULL_MOVE_MIN_DEPTH):
+            staticScore = turnMultiplier * scoreBoard(gs)
+        if depth <= 2 and staticScore + RAZOR_MARGIN * depth <= alpha:
+            score = quiescence(gs, validMoves, alpha, beta, turnMultiplier)
+            if score <= alpha:
+                return score
+        if (allowNull and depth >= NULL_MOVE_MIN_DEPTH and staticScore >= beta and beta < MATE_BOUND
+                and gs.hasNonPawnMaterial()):
+            gs.makeNullMove()
+            nextMoves = gs.getLegalMoveCodes()
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1 - NULL_MOVE_REDUCTION, -beta, -beta + NULL_WINDOW,
+                                              -turnMultiplier, False)
+            gs.undoNullMove()
+            if score >= beta:
+                return beta if score >= MATE_BOUND else score  # a mate found after passing is not real
+    futile = depth == 1 and staticScore is not None and staticScore + FUTILITY_MARGIN <= alpha
+
+    alphaOrig = alpha
     maxScore = -CHECKMATE
-    validMoves = orderMoves(gs, validMoves)
-    validMoves = validMoves[:10]
-    for move in validMoves:
+    bestMove = 0
+    killerPly = min(ply, MAX_PLY - 1)
+    killers = killerMoves[killerPly]
+    validMoves = orderMoves(gs, validMoves, ttMove, killerPly)
+    for i, move in enumerate(validMoves):
         gs.makeMove(move)
-        nextMoves = gs.getValidMoves()
-        score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -alpha, -turnMultiplier)
+        quiet = not (move >> 21 or move >> 12 & 3 == Bb.PROMOTION or gs.inCheck())
+        if futile and quiet and i > 0:
+            gs.undoMove()
+            if staticScore + FUTILITY_MARGIN > maxScore:
+                maxScore = staticScore + FUTILITY_MARGIN
+            continue
+        nextMoves = gs.getLegalMoveCodes()
+        if i == 0:
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -alpha, -turnMultiplier)
+        else:
+            reduction = 0
+            if depth >= LMR_MIN_DEPTH and i >= LMR_MIN_MOVES and quiet and not inCheck and move not in killers:
+                reduction = min(1 if i < 8 else 2, depth - 2)
+            # principal variation search: a later move only has to be shown no better than alpha
+            score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1 - reduction, -alpha - NULL_WINDOW, -alpha, -turnMultiplier)
+            if score > alpha and reduction:
+                score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -alpha - NULL_WINDOW, -alpha, -turnMultiplier)
+            if alpha < score < beta:
+                score = -findMoveNegaMaxAlphaBeta(gs, nextMoves, depth - 1, -beta, -alpha, -turnMultiplier)
         if score > maxScore:
             maxScore = score
-            if depth == DEPTH:
-                nextMove = move
+            bestMove = move
         gs.undoMove()
         if maxScore > alpha:  # pruning happens
             alpha = maxScore
         if alpha >= beta:
+            if not Bb.moveCaptured(move) and Bb.moveFlag(move) != Bb.PROMOTION:
+                updateQuietCutoff(gs, move, depth, killerPly)
             break
 
-    transpositionTable[boardHash] = (depth, maxScore)
+    if maxScore <= alphaOrig:
+        bound = Tt.UPPER
+    elif maxScore >= beta:
+        bound = Tt.LOWER
+    else:
+        bound = Tt.EXACT
+    transpositionTable.store(boardHash, depth, scoreToTt(maxScore, ply), bound, bestMove)
     return maxScore
 
+def scoreTerminal(gs, validMoves):
+    """
+    Score of a position where the game is over, from white's point of view as scoreBoard, found from its
+    legal moves without touching the checkmate and draw state of gs (see GameState.getOutcome). A mate
+    scores less the further it is from the search root (gs.position.ply), so the search goes for the
+    shortest mate and puts off being mated as long as it can.
+
+    Returns:
+        float or None: CHECKMATE - ply for white, -(CHECKMATE - ply) for black or DRAW, None if the game goes on
+    """
+    outcome = gs.getOutcome(validMoves)
+    if outcome is None:
+        return None
+    if outcome == "checkmate":
+        mate = CHECKMATE - min(gs.position.ply, MAX_PLY - 1)
+        return -mate if gs.whiteToMove else mate
+    return DRAW
+
+def scoreToTt(score, ply):
+    """
+    Mate scores count plies from the search root, the transposition table counts them from the node
+    instead, so an entry stays right when the position comes up at another ply.
+    """
+    if score >= MATE_BOUND:
+        return score + ply
+    if score <= -MATE_BOUND:
+        return score - ply
+    return score
+
+def scoreFromTt(score, ply):
+    """
+    Inverse of scoreToTt for a node ply plies from the search root.
+    """
+    if score >= MATE_BOUND:
+        return score - ply
+    if score <= -MATE_BOUND:
+        return score + ply
+    return score
+
 def scoreBoard(gs):
     """
     Evaluates and scores the board position.
@@ -196,67 +968,46 @@ def scoreBoard(gs):
     elif gs.draw:
         return DRAW
 
-    score = 0
-
-    # Material and positional scoring
-    for row in range(len(gs.board)):
-        for col in range(len(gs.board[row])):
-            square = gs.board[row][col]
-            if square != 0:
-                # Score it positionally
-                piecePositionScore = 0
-                if square % 10 != 6:  # No position table for king, yet
-                    if square % 10 == 1:  # For pawns
-                        piecePositionScore = piecePositionScores[int(square)][row][col]
-                    else:  # For other pieces
-                        piecePositionScore = piecePositionScores[int(square % 10)][row][col]
-
-                if square // 10 == 1:  # White piece
-                    score += pieceScore[int(square % 10)] + piecePositionScore * 0.05
-                elif square // 10 == 2:  # Black piece
-                    score -= pieceScore[int(square % 10)] + piecePositionScore * 0.05
+    if EVALUATOR == "nnue":
+        # Network score for the side to move, its first layer kept up to date by makeMove
+        score = gs.position.evaluateNnue() / 100
+        return score if gs.whiteToMove else -score
 
+    # Material, piece-square and center control scores, kept up to date by makeMove and undoMove
+    score = gs.position.pieceSquareScore / 100
 
     # Additional scoring conditions
 
     # 1. King safety
-    score += evaluateKingSafety(gs, True)
-    score -= evaluateKingSafety(gs, False)
-
-    # 2. Control of the center
-    centerSquares = [(3, 3), (3, 4), (4, 3), (4, 4)]
-    for r, c in centerSquares:
-        piece = gs.board[r][c]
-        if piece != 0:
-            if piece // 10 == 1:  # White controls center
-                score += 1
-            elif piece // 10 == 2:  # Black controls center
-                score -= 1
-
-    # 3. Pawn structure
-    score += evaluatePawnStructure(gs)
-
-    # 4. Mobility (number of valid moves)
-    whiteMoves = len(gs.getValidMoves()) if gs.whiteToMove else 0
-    blackMoves = len(gs.getValidMoves()) if not gs.whiteToMove else 0
-    score += 0.05 * whiteMoves
-    score -= 0.05 * blackMoves
+    pieces = gs.position.pieces
+    score += evaluateKingSafety(gs, True, pieces)
+    score -= evaluateKingSafety(gs, False, pieces)
+
+    # 2. Pawn structure
+    score += evaluatePawnStructure(gs, pieces)
+
+    # 3. Mobility (number of pseudo-legal moves of both sides, counted without generating them)
+    score += MOBILITY_SCORE * gs.position.mobility(Bb.WHITE)
+    score -= MOBILITY_SCORE * gs.position.mobility(Bb.BLACK)
 
     return score
 
-def evaluateKingSafety(gs, isWhite):
+def evaluateKingSafety(gs, isWhite, pieces=None):
     """
     Evaluates the safety of the king for a given side.
 
     Parameters:
         gs (GameState): Current game state.
         isWhite (bool): True for white king, False for black king.
+        pieces (list): Position.pieces, read from the position if None.
 
     Returns:
         float: King safety score (positive is safer).
     """
-    kingPosition = gs.whiteKingLocation if isWhite else gs.blackKingLocation
-    kingRow, kingCol = kingPosition
+    if pieces is None:
+        pieces = gs.position.pieces
+    pawns = pieces[11] | pieces[21]
+    kingRow, kingCol = divmod(gs.position.kingSquare(Bb.WHITE if isWhite else Bb.BLACK), 8)
     safetyScore = 0
 
     # Penalize if the king is in the center
@@ -266,50 +1017,204 @@ def evaluateKingSafety(gs, isWhite):
     # Penalize if the king is exposed (no pawns nearby)
     pawnRow = kingRow - 1 if isWhite else kingRow + 1
     if 0 <= pawnRow < 8:
-        if kingCol - 1 >= 0 and gs.board[pawnRow][kingCol - 1] % 10 == 1:
+        if kingCol - 1 >= 0 and pawns >> (pawnRow * 8 + kingCol - 1) & 1:
             safetyScore += 2  # Pawn on the left
-        if kingCol + 1 < 8 and gs.board[pawnRow][kingCol + 1] % 10 == 1:
+        if kingCol + 1 < 8 and pawns >> (pawnRow * 8 + kingCol + 1) & 1:
             safetyScore += 2  # Pawn on the right
 
     return safetyScore
 
-def evaluatePawnStructure(gs):
+def pawnMasks():
+    """
+    Bitboards for the pawn structure terms.
+
+    Returns:
+        tuple: (files, adjacent, passed, support) where files[col] and adjacent[col] are the file and the files
+            beside it, passed[color][sq] the squares ahead of a pawn on its own and the adjacent files (it is
+            passed if no enemy pawn stands there) and support[color][sq] the squares beside and behind it on
+            the adjacent files, where a friendly pawn could cover its advance
     """
-    Evaluates the pawn structure for both sides.
+    files = [Bb.FILE_A << col for col in range(8)]
+    adjacent = [(files[col - 1] if col > 0 else 0) | (files[col + 1] if col < 7 else 0) for col in range(8)]
+    passed = [None, [0] * 64, [0] * 64]
+    support = [None, [0] * 64, [0] * 64]
+    for sq in range(64):
+        row, col = divmod(sq, 8)
+        above = (1 << row * 8) - 1  # rows before this one, where white pawns are heading
+        below = Bb.FULL ^ ((1 << (row + 1) * 8) - 1)
+        passed[Bb.WHITE][sq] = (files[col] | adjacent[col]) & above
+        passed[Bb.BLACK][sq] = (files[col] | adjacent[col]) & below
+        support[Bb.WHITE][sq] = adjacent[col] & ~above & Bb.FULL
+        support[Bb.BLACK][sq] = adjacent[col] & ~below & Bb.FULL
+    return files, adjacent, passed, support
+
+PAWN_FILES, ADJACENT_FILES, PASSED_MASKS, SUPPORT_MASKS = pawnMasks()
+
+"""
+Pawn structure scores of this process by pawn key (see evaluatePawnStructure).
+"""
+pawnTable = Ph.PawnHashTable(PAWN_TABLE_ENTRIES)
+
+def evaluatePawnStructure(gs, pieces=None):
+    """
+    Evaluates the pawn structure for both sides. The score only depends on the pawns, so it is cached
+    in pawnTable by the pawn key of the position.
 
     Parameters:
         gs (GameState): Current game state.
+        pieces (list): Position.pieces, read from the position if None.
 
     Returns:
         float: Pawn structure score (positive for white, negative for black).
     """
-    score = 0
-    whitePawns = [col for row in gs.board for col in row if col == 11]
-    blackPawns = [col for row in gs.board for col in row if col == 21]
+    pawnKey = gs.position.pawnKey
+    score = pawnTable.probe(pawnKey)
+    if score is not None:
+        return score
+    if pieces is None:
+        pieces = gs.position.pieces
+    score = evaluatePawns(pieces[11], pieces[21], Bb.WHITE) - evaluatePawns(pieces[21], pieces[11], Bb.BLACK)
+    pawnTable.store(pawnKey, score)
+    return score
+
+def evaluatePawns(pawns, enemyPawns, color):
+    """
+    Scores the pawns of one side: doubled, isolated and backward pawns are penalized, pawns standing
+    next to each other on a row and passed pawns are rewarded.
+
+    Parameters:
+        pawns (int): Bitboard of the pawns to score.
+        enemyPawns (int): Bitboard of the other side's pawns.
+        color (int): Bitboard.WHITE or Bitboard.BLACK, the side of pawns.
 
+    Returns:
+        float: Score, positive is good for that side.
+    """
+    score = 0
     # Penalize doubled pawns
     for col in range(8):
-        whitePawnsInCol = sum(1 for row in range(8) if gs.board[row][col] == 11)
-        blackPawnsInCol = sum(1 for row in range(8) if gs.board[row][col] == 21)
-        if whitePawnsInCol > 1:
-            score -= 0.2 * (whitePawnsInCol - 1)  # Penalize doubled white pawns
-        if blackPawnsInCol > 1:
-            score += 0.2 * (blackPawnsInCol - 1)  # Penalize doubled black pawns
-
-    # Reward connected pawns
-    for row in range(8):
-        for col in range(8):
-            if gs.board[row][col] == 11:  # White pawn
-                if col - 1 >= 0 and gs.board[row][col - 1] == 11:
-                    score += 0.1  # Connected white pawn
-                if col + 1 < 8 and gs.board[row][col + 1] == 11:
-                    score += 0.1  # Connected white pawn
-            elif gs.board[row][col] == 21:  # Black pawn
-                if col - 1 >= 0 and gs.board[row][col - 1] == 21:
-                    score -= 0.1  # Connected black pawn
-                if col + 1 < 8 and gs.board[row][col + 1] == 21:
-                    score -= 0.1  # Connected black pawn
+        pawnsInCol = Bb.popCount(pawns & PAWN_FILES[col])
+        if pawnsInCol > 1:
+            score -= 0.2 * (pawnsInCol - 1)
 
+    # Reward connected pawns, 0.1 for each pawn of a pair standing side by side
+    score += 0.2 * Bb.popCount(pawns & (pawns >> 1) & Bb.NOT_FILE_H)
+
+    bb = pawns
+    while bb:
+        bit = bb & -bb
+        sq = bit.bit_length() - 1
+        bb ^= bit
+        row, col = divmod(sq, 8)
+        if not enemyPawns & PASSED_MASKS[color][sq]:
+            score += PASSED_PAWN_SCORES[6 - row if color == Bb.WHITE else row - 1]
+        if not pawns & ADJACENT_FILES[col]:
+            score -= ISOLATED_PAWN_PENALTY
+        elif not pawns & SUPPORT_MASKS[color][sq]:
+            stop = sq - 8 if color == Bb.WHITE else sq + 8
+            if Bb.PAWN_ATTACKS[color][stop] & enemyPawns:
+                score -= BACKWARD_PAWN_PENALTY
+    return score
+
+def scoreBoards(boards):
+    """
+    Evaluates many positions at once with numpy array operations instead of one scoreBoard call each,
+    for analysis and tuning. Scores material, piece-square tables, center control, king safety and pawn
+    structure as scoreBoard does. Mobility needs the moves and is left out, and the boards are not
+    checked for checkmate or draw.
+
+    Parameters:
+        boards (array-like): (N, 8, 8) piece codes, e.g. np.array([gs.board for gs in states]).
+            Every board needs both kings.
+
+    Returns:
+        np.ndarray: (N,) scores, positive for white advantage
+    """
+    boards = np.asarray(boards, dtype=np.int64)
+    count = len(boards)
+    rows = np.arange(count)
+
+    # Material, piece-square and center control scores
+    score = PIECE_SQUARE_TABLE[boards.reshape(count, 64), np.arange(64)].sum(axis=1) / 100
+
+    # King safety
+    pawns = np.zeros((count, 10, 10), dtype=bool)  # a border of empty squares around the board
+    pawns[:, 1:9, 1:9] = (boards == 11) | (boards == 21)
+    for king, direction, sign in ((16, -1, 1), (26, 1, -1)):
+        kingRow, kingCol = np.divmod((boards == king).reshape(count, 64).argmax(axis=1), 8)
+        safety = np.where((kingRow >= 2) & (kingRow <= 5) & (kingCol >= 2) & (kingCol <= 5), -2, 0)
+        pawnRow = kingRow + direction + 1
+        safety += 2 * pawns[rows, pawnRow, kingCol] + 2 * pawns[rows, pawnRow, kingCol + 2]
+        score += sign * safety
+
+    # Pawn structure
+    white = boards == 11
+    black = boards == 21
+    score += scorePawnArrays(white, black, True) - scorePawnArrays(black, white, False)
+    return score
+
+def scorePawnArrays(pawns, enemyPawns, isWhite):
+    """
+    evaluatePawns for a batch of boards.
+
+    Parameters:
+        pawns (np.ndarray): (N, 8, 8) bool, the pawns to score.
+        enemyPawns (np.ndarray): (N, 8, 8) bool, the other side's pawns.
+        isWhite (bool): True if pawns are white.
+
+    Returns:
+        np.ndarray: (N,) scores, positive is good for the side of pawns
+    """
+    rowIndex = np.arange(8)[None, :, None]
+    # Doubled and connected pawns
+    inCol = pawns.sum(axis=1)
+    score = -0.2 * np.maximum(inCol - 1, 0).sum(axis=1)
+    score += 0.2 * (pawns[:, :, :-1] & pawns[:, :, 1:]).sum(axis=(1, 2))
+
+    def besideFiles(perFile, combine, empty):
+        # value of the two neighbouring files, for every file
+        left = np.full_like(perFile, empty)
+        right = np.full_like(perFile, empty)
+        left[:, 1:] = perFile[:, :-1]
+        right[:, :-1] = perFile[:, 1:]
+        return combine(left, right)
+
+    # Rows of the most and least advanced pawns of each file, 8 or -1 for none. White pawns advance
+    # towards row 0, black ones towards row 7
+    if isWhite:
+        ownBack = np.where(pawns, rowIndex, -1).max(axis=1)
+        enemyFront = np.where(enemyPawns, rowIndex, 8).min(axis=1)
+        enemyFront = np.minimum(enemyFront, besideFiles(enemyFront, np.minimum, 8))
+        passed = pawns & (enemyFront[:, None, :] >= rowIndex)
+        advance = np.clip(6 - np.arange(8), 0, 5)
+    else:
+        ownBack = np.where(pawns, rowIndex, 8).min(axis=1)
+        enemyFront = np.where(enemyPawns, rowIndex, -1).max(axis=1)
+        enemyFront = np.maximum(enemyFront, besideFiles(enemyFront, np.maximum, -1))
+        passed = pawns & (enemyFront[:, None, :] <= rowIndex)
+        advance = np.clip(np.arange(8) - 1, 0, 5)
+    score += (passed * np.array(PASSED_PAWN_SCORES)[advance][None, :, None]).sum(axis=(1, 2))
+
+    # Isolated pawns
+    neighbours = besideFiles(inCol > 0, np.logical_or, False)
+    isolated = pawns & ~neighbours[:, None, :]
+    score -= ISOLATED_PAWN_PENALTY * isolated.sum(axis=(1, 2))
+
+    # Backward pawns: every pawn on the adjacent files is further advanced, and an enemy pawn holds the square ahead
+    if isWhite:
+        supportBack = besideFiles(ownBack, np.maximum, -1)
+        unsupported = supportBack[:, None, :] < rowIndex
+        held = np.zeros_like(pawns)
+        held[:, 2:, 1:] |= enemyPawns[:, :-2, :-1]
+        held[:, 2:, :-1] |= enemyPawns[:, :-2, 1:]
+    else:
+        supportBack = besideFiles(ownBack, np.minimum, 8)
+        unsupported = supportBack[:, None, :] > rowIndex
+        held = np.zeros_like(pawns)
+        held[:, :-2, 1:] |= enemyPawns[:, 2:, :-1]
+        held[:, :-2, :-1] |= enemyPawns[:, 2:, 1:]
+    backward = pawns & ~isolated & unsupported & held
+    score -= BACKWARD_PAWN_PENALTY * backward.sum(axis=(1, 2))
     return score
 
 def findBestMoveMinMax(gs, validMoves, returnQueue):
@@ -318,7 +1223,7 @@ def findBestMoveMinMax(gs, validMoves, returnQueue):
 
     Parameters:
         gs (GameState): Current game state.
-        validMoves (list): List of valid moves.
+        validMoves (list): List of valid moves (encoded ints).
         returnQueue (multiprocessing.Queue): Queue to return the best move.
 
     Returns:
@@ -336,7 +1241,7 @@ def findMoveMinMax(gs, validMoves, depth, whiteToMove):
 
     Parameters:
         gs (GameState): Current game state.
-        validMoves (list): List of valid moves.
+        validMoves (list): List of valid moves (encoded ints).
         depth (int): Search depth.
         whiteToMove (bool): True if white's turn, False otherwise.
 
@@ -344,6 +1249,9 @@ def findMoveMinMax(gs, validMoves, depth, whiteToMove):
         float: Evaluation score of the position.
     """
     global nextMove
+    terminal = scoreTerminal(gs, validMoves)
+    if terminal is not None:
+        return terminal
     if depth == 0:
         return scoreBoard(gs)
     
@@ -351,7 +1259,7 @@ def findMoveMinMax(gs, validMoves, depth, whiteToMove):
         maxScore = -CHECKMATE
         for move in validMoves:
             gs.makeMove(move)
-            nextMoves = gs.getValidMoves()
+            nextMoves = gs.getLegalMoveCodes()
             score = findMoveMinMax(gs, nextMoves, depth - 1, False)
             if score > maxScore:
                 maxScore = score
@@ -364,7 +1272,7 @@ def findMoveMinMax(gs, validMoves, depth, whiteToMove):
         minScore = CHECKMATE
         for move in validMoves:
             gs.makeMove(move)
-            nextMoves = gs.getValidMoves()
+            nextMoves = gs.getLegalMoveCodes()
             score = findMoveMinMax(gs, nextMoves, depth - 1, True)
             if score < minScore:
                 minScore = score
@@ -373,39 +1281,205 @@ def findMoveMinMax(gs, validMoves, depth, whiteToMove):
             gs.undoMove()
         return minScore
 
-def getMove(gs, validMoves):
+class SearchController():
+    """
+    Runs findBestMove in a background thread, so the caller (the UI) stays responsive while the AI thinks
+    and can stop it at any time. Stopping sets searchControl[STOP], which every worker checks at every
+    node, and returns the best move of the last completed iteration.
+
+    Pondering: after the AI moved, it can go on searching the position after the reply it expects (the
+    second move of its principal variation) while the opponent thinks. If the opponent plays that move,
+    ponderhit turns the running search into the real one with the normal time budget counted from then
+    on, otherwise the ponder search is stopped and its work stays in the transposition table.
+    """
+    def __init__(self):
+        self.thread = None
+        self.returnQueue = None
+        self.timer = None
+        self.ponderKey = None  # Zobrist key of the position pondered on, None if not pondering
+        self.ponderLimits = None
+        self.bestMove = None
+
+    def start(self, gs, limits=None, ponderMove=None):
+        """
+        Start searching, after stopping any search still running.
+
+        Parameters:
+            gs (GameState): Position to search. It is copied, so the caller may change it afterwards.
+            limits (SearchLimits): Thinking budget, a fixed depth of DEPTH if None.
+            ponderMove (int): Search the position after this move instead, without a time limit until
+                ponderhit (the depth and node limits still apply).
+        Returns:
+            bool: False if there is nothing to search (no legal move, or the game ends with ponderMove)
+        """
+        self.stop()
+        gs = CsE.GameState.fromSnapshot(gs.snapshot(), gs.positionCounts)
+        if ponderMove:
+            gs.makeMove(ponderMove)
+        validMoves = gs.getLegalMoveCodes()
+        if not validMoves or (ponderMove and gs.getOutcome(validMoves) is not None):
+            return False
+        if limits is None:
+            limits = SearchLimits(depth=DEPTH)
+        if ponderMove:
+            self.ponderKey = gs.getBoardHash()
+            self.ponderLimits = limits
+            limits = SearchLimits(nodes=limits.nodes, depth=limits.depth)
+        self.bestMove = None
+        self.returnQueue = Queue()
+        searchControl[STOP] = 0
+        self.thread = threading.Thread(target=findBestMove, args=(gs, validMoves, self.returnQueue, limits), daemon=True)
+        self.thread.start()
+        return True
+
+    def ponder(self, gs, limits=None):
+        """
+        Start pondering on the reply expected to the last search, if it found one.
+
+        Parameters:
+            gs (GameState): Position after the move of the last search.
+            limits (SearchLimits): Budget of the real search, applied at ponderhit.
+        Returns:
+            bool: True if pondering started
+        """
+        pv = lastSearchInfo.get("pv", [])
+        if len(pv) < 2 or pv[1] not in gs.getLegalMoveCodes():
+            return False
+        return self.start(gs, limits, pv[1])
+
+    def ponderhit(self, gs):
+        """
+        The opponent made a move. If it leads to the position being pondered on, the search goes on as
+        the real one, limited from now on by the budget given to start. Otherwise pondering is stopped.
+
+        Parameters:
+            gs (GameState): Position after the opponent's move.
+        Returns:
+            bool: True if the ponder search continues as the real search
+        """
+        if self.ponderKey is None:
+            return False
+        if self.ponderKey != gs.getBoardHash():
+            self.stop()
+            return False
+        self.ponderKey = None
+        soft, _ = self.ponderLimits.allocateTime(gs.whiteToMove)
+        if soft is not None:
+            # the pondering already went into the search, so the soft limit is enough time
+            self.timer = threading.Timer(soft, self.requestStop)
+            self.timer.daemon = True
+            self.timer.start()
+        return True
+
+    def requestStop(self):
+        """
+        Tell the running search to stop without waiting for it.
+        """
+        searchControl[STOP] = 1
+
+    def isPondering(self):
+        return self.ponderKey is not None
+
+    def isSearching(self):
+        return self.thread is not None
+
+    def isDone(self):
+        """
+        Returns:
+            bool: True if the search has finished on its own (or was never started), so stop will not wait
+        """
+        return self.thread is None or not self.thread.is_alive()
+
+    def wait(self):
+        """
+        Wait for the search to finish on its own.
+
+        Returns:
+            int or None: best move found (encoded), None if no search was started
+        """
+        if self.thread is not None:
+            self.thread.join()
+            self.bestMove = self.returnQueue.get()
+            self.thread = None
+            self.returnQueue = None
+            self.ponderKey = None
+        if self.timer is not None:
+            self.timer.cancel()
+            self.timer = None
+        return self.bestMove
+
+    def stop(self):
+        """
+        Stop the search and wait for the workers to return.
+
+        Returns:
+            int or None: best move of the last completed iteration (encoded), None if no search was started
+        """
+        if self.thread is not None:
+            self.requestStop()
+        return self.wait()
+
+searchController = SearchController()
+
+def getMove(gs, validMoves, limits=None):
     """
-    Gets the best move for the current game state using multiprocessing.
+    Gets the best move for the current game state using multiprocessing, waiting for the search to end.
+    Use searchController to search without blocking.
 
     Parameters:
         gs (GameState): Current game state.
         validMoves (list): List of valid moves.
+        limits (SearchLimits): Thinking budget, e.g. one of DIFFICULTY_LEVELS. A fixed depth of DEPTH if None.
 
     Returns:
         Move or None: The best move, or None if no valid moves are available.
     """
     if not validMoves:  # Check if there are no valid moves
         return None
-        
-    returnQueue = Queue()
-    findBestMove(gs, validMoves, returnQueue)
-    return returnQueue.get()
+    if not searchController.start(gs, limits):
+        return validMoves[0]
+    return CsE.Move.fromCode(searchController.wait())
 
-def orderMoves(gs, validMoves):
+def orderMoves(gs, validMoves, ttMove=0, ply=0):
     """
-    Orders moves based on a simple heuristic to improve search efficiency.
+    Orders moves to improve search efficiency, without evaluating any position: the transposition
+    table move first, then captures and queen promotions by MVV-LVA, then the killer moves of this
+    ply, then the other quiet moves by their history score.
 
     Parameters:
         gs (GameState): Current game state.
-        validMoves (list): List of valid moves.
+        validMoves (list): List of valid moves (encoded ints).
+        ttMove (int): Best move stored in the transposition table for this position, 0 if none.
+        ply (int): Distance from the root, to pick the killer moves.
 
     Returns:
         list: Sorted list of moves (best first).
     """
+    killer0, killer1 = killerMoves[ply]
+    history = historyScores
+    base = 0 if gs.whiteToMove else 4096
     def moveHeuristic(move):
-        startScore = scoreBoard(gs)
-        gs.makeMove(move)
-        endScore = scoreBoard(gs)
-        gs.undoMove()
-        return (endScore - startScore) * (1 if gs.whiteToMove else -1)
-    return sorted(validMoves, key=moveHeuristic, reverse=True)
\ No newline at end of file
+        if move == ttMove:
+            return 1 << 40
+        if move >> 21 or move >> 12 & 15 == 15:  # capture or queen promotion
+            return (1 << 30) + mvvLva(move)
+        if move == killer0:
+            return (1 << 29) + 1
+        if move == killer1:
+            return 1 << 29
+        return history[base + (move & 4095)]
+    return sorted(validMoves, key=moveHeuristic, reverse=True)
+
+def updateQuietCutoff(gs, move, depth, ply):
+    """
+    Remember a quiet move that caused a beta cutoff: as the first killer move of its ply and in the history table.
+    """
+    killers = killerMoves[ply]
+    if killers[0] != move:
+        killers[1] = killers[0]
+        killers[0] = move
+    index = (0 if gs.whiteToMove else 4096) + (move & 4095)
+    historyScores[index] += depth * depth
+    if historyScores[index] > 1 << 20:
+        for i in range(len(historyScores)):
+            historyScores[i] >>= 1
@@ -0,0 +1,178 @@
+"""
+TranspositionTable.py
+
+Fixed-size transposition table for the search. Entries are packed into two 64-bit words and grouped
+four to a bucket (64 bytes), so the memory used is set once when the table is created and never grows.
+The table can live in shared memory and be used by several search processes at once without locks.
+
+Entry layout:
+    word 0: Zobrist key XOR word 1, with its low 8 bits replaced by the bound (bits 6-7) and the age
+            (bits 0-5). The low key bits also pick the bucket, so nothing is lost from the key check.
+    word 1: best move (bits 0-25, see Bitboard.encodeMove), depth (bits 26-31) and the score in
+            hundredths, offset to be unsigned (bits 32-63).
+
+The two words are written separately, so another process may read an entry half way through an
+update. Folding word 1 into word 0 makes such a torn entry fail the key check instead of returning
+the data of a different position.
+
+Author: Doan Quoc Kien
+"""
+EXACT = 1
+LOWER = 2  # fail high, the score is at least this
+UPPER = 3  # fail low, the score is at most this
+
+ENTRY_BYTES = 16
+BUCKET_ENTRIES = 4
+BUCKET_BYTES = ENTRY_BYTES * BUCKET_ENTRIES
+MIN_BUCKETS = 256  # the bucket index must use at least the 8 key bits the entry does not store
+MAX_DEPTH = 63
+AGE_MASK = 63
+MOVE_MASK = (1 << 26) - 1
+SCORE_OFFSET = 1 << 31
+KEY_CHECK_MASK = ~0xFF
+
+def tableBytes(sizeMB):
+    """
+    Returns:
+        int: bytes used by a table of sizeMB megabytes, a power of two number of buckets
+    """
+    buckets = MIN_BUCKETS
+    while buckets * 2 * BUCKET_BYTES <= sizeMB * 1024 * 1024:
+        buckets *= 2
+    return buckets * BUCKET_BYTES
+
+class TranspositionTable():
+    """
+    Bucketed transposition table in a flat buffer of 64-bit words.
+
+    Replacement: an entry for the same position is overwritten unless it comes from the current search,
+    is deeper and the new one is not exact. Otherwise the new entry goes to an empty slot or replaces the
+    shallowest entry, entries left over from earlier searches going first.
+    """
+    def __init__(self, sizeMB=16, buffer=None):
+        """
+        Parameters:
+            sizeMB (float): memory for the table, rounded down to a power of two number of buckets
+            buffer (writable buffer): memory to use instead of allocating it, at least sizeMB large
+                and zero filled for an empty table
+        """
+        self.sizeBytes = tableBytes(sizeMB)
+        self.buckets = self.sizeBytes // BUCKET_BYTES
+        self.mask = self.buckets - 1
+        if buffer is None:
+            buffer = bytearray(self.sizeBytes)
+        self.memory = memoryview(buffer)[:self.sizeBytes]
+        self.table = self.memory.cast("Q")
+        self.age = 0
+        self.probes = 0
+        self.hits = 0
+        self.stores = 0
+
+    def newSearch(self):
+        """
+        Start a new search: entries written from now on are preferred over older ones when replacing.
+        """
+        self.age = (self.age + 1) & AGE_MASK
+
+    def clear(self):
+        """
+        Empty the table and reset the counters, e.g. for a new game.
+        """
+        self.memory[:] = bytes(self.sizeBytes)
+        self.age = 0
+        self.resetStats()
+
+    def resetStats(self):
+        self.probes = 0
+        self.hits = 0
+        self.stores = 0
+
+    def probe(self, key):
+        """
+        Look up a position.
+
+        Parameters:
+            key (int): Zobrist key
+        Returns:
+            tuple or None: (score, depth, bound, move) if the position is stored
+        """
+        self.probes += 1
+        table = self.table
+        index = (key & self.mask) << 3
+        for i in range(index, index + 8, 2):
+            word = table[i]
+            data = table[i + 1]
+            if word and (word ^ data ^ key) & KEY_CHECK_MASK == 0:
+                self.hits += 1
+                return ((data >> 32) - SCORE_OFFSET) / 100, (data >> 26) & 63, (word >> 6) & 3, data & MOVE_MASK
+        return None
+
+    def store(self, key, depth, score, bound, move):
+        """
+        Store a search result.
+
+        Parameters:
+            key (int): Zobrist key
+            depth (int): remaining depth the score was searched to
+            score (float): score from the point of view of the side to move, kept to 1/100
+            bound (int): EXACT, LOWER or UPPER
+            move (int): best move found, 0 if none
+        """
+        table = self.table
+        age = self.age
+        index = (key & self.mask) << 3
+        depth = min(max(depth, 0), MAX_DEPTH)
+        target = -1
+        worst = 1 << 30
+        for i in range(index, index + 8, 2):
+            word = table[i]
+            if not word:
+                if worst > -1000:
+                    target = i
+                    worst = -1000
+                continue
+            data = table[i + 1]
+            oldDepth = (data >> 26) & 63
+            oldAge = word & AGE_MASK
+            if (word ^ data ^ key) & KEY_CHECK_MASK == 0:
+                if oldAge == age and oldDepth > depth and bound != EXACT:
+                    return
+                if not move:
+                    move = data & MOVE_MASK  # keep the best move found by an earlier search
+                target = i
+                break
+            value = oldDepth if oldAge == age else oldDepth - 64
+            if value < worst:
+                target = i
+                worst = value
+        self.stores += 1
+        scoreBits = int(round(score * 100)) + SCORE_OFFSET
+        scoreBits = min(max(scoreBits, 0), 0xFFFFFFFF)
+        data = scoreBits << 32 | depth << 26 | move
+        table[target] = ((key ^ data) & KEY_CHECK_MASK) | bound << 6 | age
+        table[target + 1] = data
+
+    def release(self):
+        """
+        Let go of the buffer, which shared memory needs before it can be closed. The table is unusable afterwards.
+        """
+        self.table.release()
+        self.memory.release()
+
+    def usage(self):
+        """
+        Returns:
+            int: permille of the first 1000 entries written by the current search
+        """
+        table = self.table
+        entries = min(1000, len(table) // 2)
+        used = sum(1 for i in range(0, entries * 2, 2) if table[i] and table[i] & AGE_MASK == self.age)
+        return used * 1000 // entries
+
+    def stats(self):
+        """
+        Returns:
+            dict: probes, hits, hit rate and stores since the last resetStats, and the usage in permille
+        """
+        return {"probes": self.probes, "hits": self.hits, "hitRate": self.hits / max(self.probes, 1),
+                "stores": self.stores, "usage": self.usage()}
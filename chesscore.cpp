@@ -0,0 +1,1633 @@
+/*
+ * chesscore.cpp
+ *
+ * Native implementation of Bitboard.Position as a CPython extension module: piece bitboards,
+ * legal move generation, make/undo and Zobrist hashing. It mirrors the pure Python class method
+ * for method (same square numbering, move encoding, Zobrist keys and move order), so GameState
+ * can use either one. Sliding attacks use magic bitboards found at import with a fixed seed.
+ * It also runs the NNUE evaluation, which has no pure Python counterpart.
+ *
+ * Build in place with: python setup.py build_ext --inplace
+ * (CHESSCORE_NATIVE=1 to compile for this machine's instruction set, e.g. AVX2)
+ *
+ * Author: Doan Quoc Kien
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Kernel of the NNUE evaluation, chosen by the compiler flags (setup.py adds them with CHESSCORE_NATIVE=1)
+#if defined(CHESSCORE_NO_SIMD)
+#define NNUE_SIMD "scalar"
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_AVX2
+#define NNUE_SIMD "avx2"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NNUE_SSE2
+#define NNUE_SIMD "sse2"
+#else
+#define NNUE_SIMD "scalar"
+#endif
+
+typedef uint64_t U64;
+
+static const U64 FULL = ~0ULL;
+static const U64 FILE_A = 0x0101010101010101ULL;
+static const U64 FILE_H = FILE_A << 7;
+static const U64 NOT_FILE_A = ~FILE_A;
+static const U64 NOT_FILE_H = ~FILE_H;
+static const U64 ROW_3 = 0xFFULL << 40;
+static const U64 ROW_6 = 0xFFULL << 16;
+static const U64 PROMOTION_ROWS = 0xFFULL | (0xFFULL << 56);
+
+enum { NORMAL = 0, EN_PASSANT = 1, CASTLE = 2, PROMOTION = 3 };
+enum { WHITE = 1, BLACK = 2 };
+
+static inline int lsb(U64 bb) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bb);
+    return (int)index;
+#else
+    return __builtin_ctzll(bb);
+#endif
+}
+
+static inline int msb(U64 bb) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, bb);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(bb);
+#endif
+}
+
+static inline int popCount(U64 bb) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(bb);
+#else
+    return __builtin_popcountll(bb);
+#endif
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * Attack tables
+ * ------------------------------------------------------------------------------------------- */
+
+static U64 KNIGHT_ATTACKS[64];
+static U64 KING_ATTACKS[64];
+static U64 PAWN_ATTACKS[3][64];  // [color][sq], squares attacked by a pawn of that color on sq
+static U64 BETWEEN[64][64];      // squares strictly between two aligned squares
+
+struct Magic {
+    U64 mask;
+    U64 magic;
+    U64 *attacks;
+    int shift;
+};
+
+static Magic ROOK_MAGICS[64];
+static Magic BISHOP_MAGICS[64];
+static U64 ROOK_TABLE[102400];
+static U64 BISHOP_TABLE[5248];
+
+static const int ROOK_DIRECTIONS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int BISHOP_DIRECTIONS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static inline U64 rookAttacks(int sq, U64 occupied) {
+    const Magic &m = ROOK_MAGICS[sq];
+    return m.attacks[((occupied & m.mask) * m.magic) >> m.shift];
+}
+
+static inline U64 bishopAttacks(int sq, U64 occupied) {
+    const Magic &m = BISHOP_MAGICS[sq];
+    return m.attacks[((occupied & m.mask) * m.magic) >> m.shift];
+}
+
+static U64 stepAttacks(int sq, const int offsets[][2], int count) {
+    int r = sq / 8, c = sq % 8;
+    U64 bb = 0;
+    for (int i = 0; i < count; i++) {
+        int nr = r + offsets[i][0], nc = c + offsets[i][1];
+        if (nr >= 0 && nr < 8 && nc >= 0 && nc < 8)
+            bb |= 1ULL << (nr * 8 + nc);
+    }
+    return bb;
+}
+
+// Walk the rays of a slider, stopping at (and including) the first blocker; only used to fill the tables
+static U64 slidingAttacks(int sq, U64 occupied, const int directions[4][2]) {
+    U64 attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int r = sq / 8 + directions[d][0], c = sq % 8 + directions[d][1];
+        while (r >= 0 && r < 8 && c >= 0 && c < 8) {
+            U64 bit = 1ULL << (r * 8 + c);
+            attacks |= bit;
+            if (occupied & bit)
+                break;
+            r += directions[d][0];
+            c += directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+// Squares between the slider and the board edge, the only ones that can block it
+static U64 relevantMask(int sq, const int directions[4][2]) {
+    U64 mask = 0;
+    for (int d = 0; d < 4; d++) {
+        int dr = directions[d][0], dc = directions[d][1];
+        int r = sq / 8 + dr, c = sq % 8 + dc;
+        while (r + dr >= 0 && r + dr < 8 && c + dc >= 0 && c + dc < 8) {
+            mask |= 1ULL << (r * 8 + c);
+            r += dr;
+            c += dc;
+        }
+    }
+    return mask;
+}
+
+static U64 randomState = 0x2545F4914F6CDD1DULL;
+
+static U64 randomU64() {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545F4914F6CDD1DULL;
+}
+
+// Trial-and-error search for a multiplier that maps every blocker subset to a slot without a harmful collision
+static void initMagics(Magic *magics, U64 *table, const int directions[4][2]) {
+    static U64 occupancy[4096], reference[4096];
+    static int epoch[4096];
+    int attempt = 0;
+    U64 *attacks = table;
+    memset(epoch, 0, sizeof(epoch));
+    for (int sq = 0; sq < 64; sq++) {
+        Magic &m = magics[sq];
+        m.mask = relevantMask(sq, directions);
+        int bits = popCount(m.mask);
+        m.shift = 64 - bits;
+        m.attacks = attacks;
+        int size = 0;
+        U64 subset = 0;
+        do {  // enumerate every subset of the mask (carry-rippler)
+            occupancy[size] = subset;
+            reference[size] = slidingAttacks(sq, subset, directions);
+            size++;
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+        for (;;) {
+            do {
+                m.magic = randomU64() & randomU64() & randomU64();
+            } while (popCount((m.mask * m.magic) >> 56) < 6);
+            attempt++;
+            int i = 0;
+            for (; i < size; i++) {
+                unsigned index = (unsigned)((occupancy[i] * m.magic) >> m.shift);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    attacks[index] = reference[i];
+                } else if (attacks[index] != reference[i]) {
+                    break;
+                }
+            }
+            if (i == size)
+                break;
+        }
+        attacks += size;
+    }
+}
+
+static void initTables() {
+    static const int knight[8][2] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
+    static const int king[8][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    static const int whitePawn[2][2] = {{-1, -1}, {-1, 1}};
+    static const int blackPawn[2][2] = {{1, -1}, {1, 1}};
+    for (int sq = 0; sq < 64; sq++) {
+        KNIGHT_ATTACKS[sq] = stepAttacks(sq, knight, 8);
+        KING_ATTACKS[sq] = stepAttacks(sq, king, 8);
+        PAWN_ATTACKS[WHITE][sq] = stepAttacks(sq, whitePawn, 2);
+        PAWN_ATTACKS[BLACK][sq] = stepAttacks(sq, blackPawn, 2);
+    }
+    initMagics(ROOK_MAGICS, ROOK_TABLE, ROOK_DIRECTIONS);
+    initMagics(BISHOP_MAGICS, BISHOP_TABLE, BISHOP_DIRECTIONS);
+    for (int a = 0; a < 64; a++) {
+        for (int b = 0; b < 64; b++) {
+            BETWEEN[a][b] = 0;
+            if (a == b)
+                continue;
+            U64 bBit = 1ULL << b;
+            if (rookAttacks(a, 0) & bBit)
+                BETWEEN[a][b] = rookAttacks(a, bBit) & rookAttacks(b, 1ULL << a);
+            else if (bishopAttacks(a, 0) & bBit)
+                BETWEEN[a][b] = bishopAttacks(a, bBit) & bishopAttacks(b, 1ULL << a);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * Zobrist keys: the same splitmix64 sequence as Bitboard._zobristTables
+ * ------------------------------------------------------------------------------------------- */
+
+static U64 ZOBRIST_PIECES[27][64];
+static U64 ZOBRIST_SIDE;
+static U64 ZOBRIST_CASTLE[16];
+static U64 ZOBRIST_EP[8];
+
+static void initZobrist() {
+    U64 keys[12 * 64 + 1 + 4 + 8];
+    U64 state = 0x5EED;
+    for (int i = 0; i < 12 * 64 + 1 + 4 + 8; i++) {
+        state += 0x9E3779B97F4A7C15ULL;
+        U64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        keys[i] = z ^ (z >> 31);
+    }
+    static const int pieces[12] = {11, 12, 13, 14, 15, 16, 21, 22, 23, 24, 25, 26};
+    memset(ZOBRIST_PIECES, 0, sizeof(ZOBRIST_PIECES));
+    for (int i = 0; i < 12; i++)
+        for (int sq = 0; sq < 64; sq++)
+            ZOBRIST_PIECES[pieces[i]][sq] = keys[i * 64 + sq];
+    ZOBRIST_SIDE = keys[768];
+    for (int bits = 0; bits < 16; bits++) {
+        ZOBRIST_CASTLE[bits] = 0;
+        for (int i = 0; i < 4; i++)
+            if (bits >> i & 1)
+                ZOBRIST_CASTLE[bits] ^= keys[769 + i];
+    }
+    for (int file = 0; file < 8; file++)
+        ZOBRIST_EP[file] = keys[773 + file];
+}
+
+// Material and piece-square score of a piece on a square in hundredths, as Bitboard.PIECE_SQUARE_SCORES
+static int PIECE_SQUARE_SCORES[27][64];
+
+/* ---------------------------------------------------------------------------------------------
+ * NNUE evaluation
+ *
+ * HalfKP inputs: for each side (perspective), one feature per non-king piece, indexed by the square of
+ * that side's own king, the piece and its square, with the board flipped for black so both sides see
+ * themselves moving up. The first layer is the accumulator, a sum of int16 weight columns kept per ply by
+ * makeMove; the hidden layers use int8 weights on the accumulator clamped to 0..127. The file format is
+ * written and read by Nnue.py.
+ * ------------------------------------------------------------------------------------------- */
+
+#define NNUE_FEATURES (64 * 640)  // king square x 10 piece kinds (own and enemy P, N, B, R, Q) x square
+#define NNUE_L1 128               // accumulator size per perspective
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_SHIFT 6              // hidden layer weights are scaled by 64
+
+struct Network {
+    int16_t featureBias[NNUE_L1];
+    int16_t featureWeights[NNUE_FEATURES][NNUE_L1];
+    int32_t hidden1Bias[NNUE_L2];
+    int8_t hidden1Weights[NNUE_L2][2 * NNUE_L1];  // input: side to move's accumulator, then the other one
+    int32_t hidden2Bias[NNUE_L3];
+    int8_t hidden2Weights[NNUE_L3][NNUE_L2];
+    int32_t outputBias;
+    int8_t outputWeights[NNUE_L3];
+    int32_t outputScale;  // output * outputScale / 1024 is the score in hundredths
+};
+
+static Network *network = NULL;  // set by loadNetwork
+static int networkVersion = 0;   // bumped by every loadNetwork, so accumulators of an older network are recomputed
+
+static inline int featureIndex(int perspective, int king, int piece, int sq) {
+    int flip = perspective == WHITE ? 0 : 56;
+    int kind = piece % 10 - 1 + (piece / 10 == perspective ? 0 : 5);
+    return (king ^ flip) * 640 + kind * 64 + (sq ^ flip);
+}
+
+// Add (or subtract) a weight column to an accumulator, wrapping like the SIMD lanes do
+template <bool add>
+static inline void updateFeature(int16_t *values, const int16_t *weights) {
+#if defined(NNUE_AVX2)
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *)(weights + i));
+        _mm256_storeu_si256((__m256i *)(values + i), add ? _mm256_add_epi16(v, w) : _mm256_sub_epi16(v, w));
+    }
+#elif defined(NNUE_SSE2)
+    for (int i = 0; i < NNUE_L1; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+        _mm_storeu_si128((__m128i *)(values + i), add ? _mm_add_epi16(v, w) : _mm_sub_epi16(v, w));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; i++)
+        values[i] = (int16_t)(add ? values[i] + weights[i] : values[i] - weights[i]);
+#endif
+}
+
+// Clamp an accumulator to 0..127 as the uint8 input of the first hidden layer
+static inline void clampAccumulator(const int16_t *values, uint8_t *out) {
+#if defined(NNUE_AVX2)
+    const __m256i limit = _mm256_set1_epi8(127);
+    for (int i = 0; i < NNUE_L1; i += 32) {
+        __m256i packed = _mm256_packus_epi16(_mm256_loadu_si256((const __m256i *)(values + i)),
+                                             _mm256_loadu_si256((const __m256i *)(values + i + 16)));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);  // packus works per 128-bit lane
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_min_epu8(packed, limit));
+    }
+#elif defined(NNUE_SSE2)
+    const __m128i limit = _mm_set1_epi8(127);
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m128i packed = _mm_packus_epi16(_mm_loadu_si128((const __m128i *)(values + i)),
+                                          _mm_loadu_si128((const __m128i *)(values + i + 8)));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_min_epu8(packed, limit));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; i++)
+        out[i] = (uint8_t)(values[i] < 0 ? 0 : values[i] > 127 ? 127 : values[i]);
+#endif
+}
+
+// Dot product of uint8 activations and int8 weights; size is a multiple of 32
+static inline int32_t dotProduct(const uint8_t *input, const int8_t *weights, int size) {
+#if defined(NNUE_AVX2)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < size; i += 32) {
+        // pairs of 127 * 127 products fit the saturating int16 sums of maddubs
+        __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(input + i)),
+                                                _mm256_loadu_si256((const __m256i *)(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+#elif defined(NNUE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < size; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+        // widen to int16: zero-extend the activations, sign-extend the weights
+        __m128i wLow = _mm_srai_epi16(_mm_unpacklo_epi8(w, w), 8);
+        __m128i wHigh = _mm_srai_epi16(_mm_unpackhi_epi8(w, w), 8);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), wLow));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), wHigh));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += input[i] * weights[i];
+    return sum;
+#endif
+}
+
+static inline void hiddenLayer(const uint8_t *input, int inputSize, const int32_t *bias, const int8_t *weights,
+                               int outputSize, uint8_t *output) {
+    for (int i = 0; i < outputSize; i++) {
+        int32_t sum = bias[i] + dotProduct(input, weights + i * inputSize, inputSize);
+        output[i] = (uint8_t)(sum < 0 ? 0 : (sum >> NNUE_SHIFT) > 127 ? 127 : sum >> NNUE_SHIFT);
+    }
+}
+
+// Score in hundredths for the side whose accumulator is own
+static int networkOutput(const int16_t *own, const int16_t *other) {
+    uint8_t input[2 * NNUE_L1], hidden1[NNUE_L2], hidden2[NNUE_L3];
+    clampAccumulator(own, input);
+    clampAccumulator(other, input + NNUE_L1);
+    hiddenLayer(input, 2 * NNUE_L1, network->hidden1Bias, &network->hidden1Weights[0][0], NNUE_L2, hidden1);
+    hiddenLayer(hidden1, NNUE_L2, network->hidden2Bias, &network->hidden2Weights[0][0], NNUE_L3, hidden2);
+    int32_t output = network->outputBias + dotProduct(hidden2, network->outputWeights, NNUE_L3);
+    return (int)((int64_t)output * network->outputScale / 1024);
+}
+
+// First layer sums of one ply, for white (index 0) and black (index 1)
+struct Accumulator {
+    int16_t values[2][NNUE_L1];
+    int version;  // networkVersion it was computed with, 0 if it has to be computed again
+};
+
+/* ---------------------------------------------------------------------------------------------
+ * Position
+ * ------------------------------------------------------------------------------------------- */
+
+enum { WHITE_KING_SIDE = 1, WHITE_QUEEN_SIDE = 2, BLACK_KING_SIDE = 4, BLACK_QUEEN_SIDE = 8 };
+
+// Rights kept when a piece moves from or to each square, as Bitboard.CASTLE_MASK
+static int CASTLE_MASK[64];
+
+static void initCastleMask() {
+    for (int sq = 0; sq < 64; sq++)
+        CASTLE_MASK[sq] = 15;
+    CASTLE_MASK[60] = 15 ^ (WHITE_KING_SIDE | WHITE_QUEEN_SIDE);
+    CASTLE_MASK[63] = 15 ^ WHITE_KING_SIDE;
+    CASTLE_MASK[56] = 15 ^ WHITE_QUEEN_SIDE;
+    CASTLE_MASK[4] = 15 ^ (BLACK_KING_SIDE | BLACK_QUEEN_SIDE);
+    CASTLE_MASK[7] = 15 ^ BLACK_KING_SIDE;
+    CASTLE_MASK[0] = 15 ^ BLACK_QUEEN_SIDE;
+}
+
+static const int NULL_MOVE = 0;  // pushed by makeNullMove, as Bitboard.NULL_MOVE
+
+// State from before a move, everything undoMove cannot recover from the move itself
+struct UndoRecord {
+    int move;
+    int castleRights;
+    int epSquare;
+    int halfmoveClock;
+    U64 key;
+    U64 attacks[2];  // white, black
+};
+
+#define UNDO_STACK_PLIES 1024
+
+struct Board {
+    U64 pieces[27];
+    U64 colors[3];
+    U64 occupied;
+    U64 key;
+    U64 pawnKey;  // Zobrist key of the pawns alone
+    U64 attacks[3];  // squares attacked by white (1) and black (2), kept up to date by makeMove/undoMove
+    int squares[64];
+    int pieceSquareScore;  // sum of PIECE_SQUARE_SCORES over the pieces, kept up to date like the key
+    bool whiteToMove;
+    int castleRights;
+    int epSquare;
+    int halfmoveClock;
+    UndoRecord *stack;  // grown by doubling when a game outgrows it, never inside a search
+    int ply;
+    int capacity;
+    Accumulator *accumulators;  // one per ply, allocated by the first evaluateNnue
+    int accumulatorCapacity;
+
+    void clearPieces() {
+        memset(pieces, 0, sizeof(pieces));
+        memset(colors, 0, sizeof(colors));
+        memset(squares, 0, sizeof(squares));
+        occupied = 0;
+        pawnKey = 0;
+        pieceSquareScore = 0;
+    }
+
+    bool reserve(int plies) {
+        if (plies <= capacity)
+            return true;
+        int size = capacity ? capacity : UNDO_STACK_PLIES;
+        while (size < plies)
+            size *= 2;
+        UndoRecord *grown = (UndoRecord *)PyMem_Realloc(stack, size * sizeof(UndoRecord));
+        if (!grown)
+            return false;
+        stack = grown;
+        capacity = size;
+        return true;
+    }
+
+    // Accumulators for every ply the undo stack can hold
+    bool reserveAccumulators() {
+        if (accumulatorCapacity > capacity)
+            return true;
+        int size = capacity + 1;
+        Accumulator *grown = (Accumulator *)PyMem_Realloc(accumulators, size * sizeof(Accumulator));
+        if (!grown)
+            return false;
+        for (int i = accumulatorCapacity; i < size; i++)
+            grown[i].version = 0;
+        accumulators = grown;
+        accumulatorCapacity = size;
+        return true;
+    }
+
+    // Called whenever the pieces change other than by makeMove/undoMove
+    void invalidateAccumulators() {
+        for (int i = 0; i < accumulatorCapacity; i++)
+            accumulators[i].version = 0;
+    }
+
+    U64 computeKey() const {
+        U64 k = 0;
+        for (int sq = 0; sq < 64; sq++)
+            if (squares[sq])
+                k ^= ZOBRIST_PIECES[squares[sq]][sq];
+        k ^= ZOBRIST_CASTLE[castleRights];
+        k ^= enPassantKey(epSquare, whiteToMove ? WHITE : BLACK);
+        return whiteToMove ? k : k ^ ZOBRIST_SIDE;
+    }
+
+    inline void putPiece(int sq, int piece) {
+        U64 bit = 1ULL << sq;
+        squares[sq] = piece;
+        pieces[piece] |= bit;
+        colors[piece / 10] |= bit;
+        occupied |= bit;
+        key ^= ZOBRIST_PIECES[piece][sq];
+        if (piece % 10 == 1)
+            pawnKey ^= ZOBRIST_PIECES[piece][sq];
+        pieceSquareScore += PIECE_SQUARE_SCORES[piece][sq];
+    }
+
+    inline int removePiece(int sq) {
+        int piece = squares[sq];
+        U64 bit = 1ULL << sq;
+        squares[sq] = 0;
+        pieces[piece] ^= bit;
+        colors[piece / 10] ^= bit;
+        occupied ^= bit;
+        key ^= ZOBRIST_PIECES[piece][sq];
+        if (piece % 10 == 1)
+            pawnKey ^= ZOBRIST_PIECES[piece][sq];
+        pieceSquareScore -= PIECE_SQUARE_SCORES[piece][sq];
+        return piece;
+    }
+
+    // -1 if that side has no king, as Bitboard.Position.kingSquare
+    inline int kingSquare(int color) const {
+        U64 king = pieces[color * 10 + 6];
+        return king ? msb(king) : -1;
+    }
+
+    U64 enPassantKey(int epSquare, int us) const {
+        if (epSquare >= 0 && (PAWN_ATTACKS[3 - us][epSquare] & pieces[us * 10 + 1]))
+            return ZOBRIST_EP[epSquare & 7];
+        return 0;
+    }
+
+    U64 attacksOf(int color) const {
+        const U64 *own = pieces + color * 10;
+        U64 pawns = own[1];
+        U64 result = color == WHITE ? ((pawns & NOT_FILE_A) >> 9) | ((pawns & NOT_FILE_H) >> 7)
+                                    : ((pawns & NOT_FILE_A) << 7) | ((pawns & NOT_FILE_H) << 9);
+        if (own[6])
+            result |= KING_ATTACKS[lsb(own[6])];
+        for (U64 bb = own[2]; bb; bb &= bb - 1)
+            result |= KNIGHT_ATTACKS[lsb(bb)];
+        for (U64 bb = own[3] | own[5]; bb; bb &= bb - 1)
+            result |= bishopAttacks(lsb(bb), occupied);
+        for (U64 bb = own[4] | own[5]; bb; bb &= bb - 1)
+            result |= rookAttacks(lsb(bb), occupied);
+        return result;
+    }
+
+    // Pseudo-legal move count of a side from popcounts of its attack sets, as Bitboard.Position.mobility
+    int mobility(int color) const {
+        const U64 *own = pieces + color * 10;
+        U64 notOwn = ~colors[color];
+        U64 enemy = colors[3 - color];
+        U64 empty = ~occupied;
+        U64 pawns = own[1];
+        int count;
+        if (color == WHITE) {
+            U64 pushes = (pawns >> 8) & empty;
+            count = popCount(pushes) + popCount(((pushes & ROW_3) >> 8) & empty);
+            count += popCount(((pawns & NOT_FILE_A) >> 9) & enemy) + popCount(((pawns & NOT_FILE_H) >> 7) & enemy);
+        } else {
+            U64 pushes = (pawns << 8) & empty;
+            count = popCount(pushes) + popCount(((pushes & ROW_6) << 8) & empty);
+            count += popCount(((pawns & NOT_FILE_A) << 7) & enemy) + popCount(((pawns & NOT_FILE_H) << 9) & enemy);
+        }
+        if (own[6])
+            count += popCount(KING_ATTACKS[lsb(own[6])] & notOwn);
+        for (U64 bb = own[2]; bb; bb &= bb - 1)
+            count += popCount(KNIGHT_ATTACKS[lsb(bb)] & notOwn);
+        for (U64 bb = own[3] | own[5]; bb; bb &= bb - 1)
+            count += popCount(bishopAttacks(lsb(bb), occupied) & notOwn);
+        for (U64 bb = own[4] | own[5]; bb; bb &= bb - 1)
+            count += popCount(rookAttacks(lsb(bb), occupied) & notOwn);
+        return count;
+    }
+
+    void computeAttacks() {
+        attacks[0] = 0;
+        attacks[WHITE] = attacksOf(WHITE);
+        attacks[BLACK] = attacksOf(BLACK);
+    }
+
+    inline bool isSquareAttacked(int sq, int byColor) const {
+        return (attacks[byColor] >> sq) & 1;
+    }
+
+    inline bool inCheck() const {
+        return whiteToMove ? (attacks[BLACK] & pieces[16]) != 0 : (attacks[WHITE] & pieces[26]) != 0;
+    }
+
+    bool isAttackedAfter(int sq, int byColor, U64 occ, U64 captured) const {
+        int base = byColor * 10;
+        U64 alive = ~captured;
+        if (KNIGHT_ATTACKS[sq] & pieces[base + 2] & alive)
+            return true;
+        if (PAWN_ATTACKS[3 - byColor][sq] & pieces[base + 1] & alive)
+            return true;
+        if (KING_ATTACKS[sq] & pieces[base + 6])
+            return true;
+        U64 queens = pieces[base + 5];
+        if (rookAttacks(sq, occ) & (pieces[base + 4] | queens) & alive)
+            return true;
+        if (bishopAttacks(sq, occ) & (pieces[base + 3] | queens) & alive)
+            return true;
+        return false;
+    }
+
+    void movePieces(int move) {
+        int start = move & 63, end = move >> 6 & 63, flag = move >> 12 & 3;
+        int piece = removePiece(start);
+        if (flag == EN_PASSANT)
+            removePiece((start & ~7) | (end & 7));
+        else if (move >> 21)
+            removePiece(end);
+        if (flag == PROMOTION)
+            piece = piece - 1 + (move >> 14 & 3) + 2;
+        putPiece(end, piece);
+        if (flag == CASTLE) {
+            if (end > start)
+                putPiece(end - 1, removePiece(end + 1));
+            else
+                putPiece(end + 1, removePiece(end - 2));
+        }
+    }
+
+    void unmovePieces(int move) {
+        int start = move & 63, end = move >> 6 & 63, flag = move >> 12 & 3;
+        int captured = move >> 21 & 31;
+        removePiece(end);
+        putPiece(start, move >> 16 & 31);
+        if (flag == EN_PASSANT) {
+            putPiece((start & ~7) | (end & 7), captured);
+        } else if (captured) {
+            putPiece(end, captured);
+        } else if (flag == CASTLE) {
+            if (end > start)
+                putPiece(end + 1, removePiece(end - 1));
+            else
+                putPiece(end - 2, removePiece(end + 1));
+        }
+    }
+
+    // Same updates as Bitboard.Position.makeMove; false only if the undo stack could not grow
+    bool makeMove(int move) {
+        if (ply == capacity && !reserve(ply + 1))
+            return false;
+        UndoRecord &record = stack[ply++];
+        record.move = move;
+        record.castleRights = castleRights;
+        record.epSquare = epSquare;
+        record.halfmoveClock = halfmoveClock;
+        record.key = key;
+        record.attacks[0] = attacks[WHITE];
+        record.attacks[1] = attacks[BLACK];
+
+        int us = whiteToMove ? WHITE : BLACK;
+        key ^= ZOBRIST_CASTLE[castleRights] ^ enPassantKey(epSquare, us) ^ ZOBRIST_SIDE;
+        movePieces(move);
+        int start = move & 63, end = move >> 6 & 63;
+        castleRights &= CASTLE_MASK[start] & CASTLE_MASK[end];
+        whiteToMove = !whiteToMove;
+        if ((move >> 16 & 31) % 10 == 1) {
+            halfmoveClock = 0;
+            epSquare = (start - end == 16 || end - start == 16) ? (start + end) >> 1 : -1;
+        } else {
+            halfmoveClock = (move >> 21) ? 0 : halfmoveClock + 1;
+            epSquare = -1;
+        }
+        key ^= ZOBRIST_CASTLE[castleRights] ^ enPassantKey(epSquare, 3 - us);
+        // As in Bitboard.Position.makeMove, the opponent's map only changes if it lost a piece or a square
+        // it attacks was emptied or filled
+        attacks[us] = attacksOf(us);
+        if ((move >> 21) || (((1ULL << start) | (1ULL << end)) & attacks[3 - us]) || (move >> 12 & 3) == CASTLE)
+            attacks[3 - us] = attacksOf(3 - us);
+        if (ply < accumulatorCapacity)
+            updateAccumulator(move, us);
+        return true;
+    }
+
+    bool makeNullMove() {
+        if (ply == capacity && !reserve(ply + 1))
+            return false;
+        UndoRecord &record = stack[ply++];
+        record.move = NULL_MOVE;
+        record.castleRights = castleRights;
+        record.epSquare = epSquare;
+        record.halfmoveClock = halfmoveClock;
+        record.key = key;
+        record.attacks[0] = attacks[WHITE];
+        record.attacks[1] = attacks[BLACK];
+        key ^= enPassantKey(epSquare, whiteToMove ? WHITE : BLACK) ^ ZOBRIST_SIDE;
+        epSquare = -1;
+        halfmoveClock++;
+        whiteToMove = !whiteToMove;
+        if (ply < accumulatorCapacity)
+            accumulators[ply] = accumulators[ply - 1];
+        return true;
+    }
+
+    int undoMove() {
+        const UndoRecord &record = stack[--ply];
+        if (record.move != NULL_MOVE)
+            unmovePieces(record.move);
+        castleRights = record.castleRights;
+        epSquare = record.epSquare;
+        halfmoveClock = record.halfmoveClock;
+        key = record.key;
+        attacks[WHITE] = record.attacks[0];
+        attacks[BLACK] = record.attacks[1];
+        whiteToMove = !whiteToMove;
+        return record.move;
+    }
+
+    inline int nnueKing(int perspective) const {
+        int king = kingSquare(perspective);
+        return king < 0 ? 0 : king;
+    }
+
+    void refreshAccumulator(Accumulator &accumulator, int perspective) const {
+        int16_t *values = accumulator.values[perspective - 1];
+        memcpy(values, network->featureBias, sizeof(network->featureBias));
+        int king = nnueKing(perspective);
+        for (U64 bb = occupied & ~pieces[16] & ~pieces[26]; bb; bb &= bb - 1) {
+            int sq = lsb(bb);
+            updateFeature<true>(values, network->featureWeights[featureIndex(perspective, king, squares[sq], sq)]);
+        }
+    }
+
+    // Accumulator of the new ply from the one before the move: only the features of the moved, captured and
+    // castling rook pieces change, except for the side whose king moved, which sums its features again.
+    // Left to evaluateNnue if the previous ply was never evaluated.
+    void updateAccumulator(int move, int us) {
+        const Accumulator &parent = accumulators[ply - 1];
+        Accumulator &child = accumulators[ply];
+        if (!network || parent.version != networkVersion) {
+            child.version = 0;
+            return;
+        }
+        int start = move & 63, end = move >> 6 & 63, flag = move >> 12 & 3;
+        int piece = move >> 16 & 31, captured = move >> 21 & 31;
+        int capturedSquare = flag == EN_PASSANT ? (start & ~7) | (end & 7) : end;
+        for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+            if (piece == perspective * 10 + 6) {
+                refreshAccumulator(child, perspective);
+                continue;
+            }
+            int16_t *values = child.values[perspective - 1];
+            const int16_t (*weights)[NNUE_L1] = network->featureWeights;
+            int king = nnueKing(perspective);
+            memcpy(values, parent.values[perspective - 1], sizeof(parent.values[0]));
+            if (piece % 10 != 6) {
+                updateFeature<false>(values, weights[featureIndex(perspective, king, piece, start)]);
+                updateFeature<true>(values, weights[featureIndex(perspective, king, squares[end], end)]);
+            }
+            if (captured)
+                updateFeature<false>(values, weights[featureIndex(perspective, king, captured, capturedSquare)]);
+            if (flag == CASTLE) {
+                int rook = us * 10 + 4;
+                int from = end > start ? end + 1 : end - 2, to = end > start ? end - 1 : end + 1;
+                updateFeature<false>(values, weights[featureIndex(perspective, king, rook, from)]);
+                updateFeature<true>(values, weights[featureIndex(perspective, king, rook, to)]);
+            }
+        }
+        child.version = networkVersion;
+    }
+
+    // Network score for the side to move in hundredths; needs a network and reserveAccumulators
+    int evaluateNnue() {
+        Accumulator &accumulator = accumulators[ply];
+        if (accumulator.version != networkVersion) {
+            refreshAccumulator(accumulator, WHITE);
+            refreshAccumulator(accumulator, BLACK);
+            accumulator.version = networkVersion;
+        }
+        int us = whiteToMove ? WHITE : BLACK;
+        return networkOutput(accumulator.values[us - 1], accumulator.values[2 - us]);
+    }
+
+    static inline void addTargets(int start, U64 targets, const int *squares, int *moves, int &count) {
+        while (targets) {
+            int end = lsb(targets);
+            targets &= targets - 1;
+            moves[count++] = start | end << 6 | squares[end] << 21;
+        }
+    }
+
+    void addPawnMoves(int us, U64 pawns, U64 target, int *moves, int &count) const {
+        U64 empty = ~occupied;
+        U64 enemy = colors[3 - us];
+        int piece = (us * 10 + 1) << 16;
+        U64 sets[4];
+        int deltas[4];
+        if (us == WHITE) {
+            sets[0] = (pawns >> 8) & empty;
+            sets[1] = ((sets[0] & ROW_3) >> 8) & empty;
+            sets[2] = ((pawns & NOT_FILE_A) >> 9) & enemy;
+            sets[3] = ((pawns & NOT_FILE_H) >> 7) & enemy;
+            deltas[0] = 8; deltas[1] = 16; deltas[2] = 9; deltas[3] = 7;
+        } else {
+            sets[0] = (pawns << 8) & empty;
+            sets[1] = ((sets[0] & ROW_6) << 8) & empty;
+            sets[2] = ((pawns & NOT_FILE_A) << 7) & enemy;
+            sets[3] = ((pawns & NOT_FILE_H) << 9) & enemy;
+            deltas[0] = -8; deltas[1] = -16; deltas[2] = -7; deltas[3] = -9;
+        }
+        for (int i = 0; i < 4; i++) {
+            U64 targets = sets[i] & target;
+            while (targets) {
+                int end = lsb(targets);
+                targets &= targets - 1;
+                int move = (end + deltas[i]) | end << 6 | piece | squares[end] << 21;
+                if ((1ULL << end) & PROMOTION_ROWS) {
+                    move |= PROMOTION << 12;
+                    moves[count++] = move | 3 << 14;  // queen first
+                    moves[count++] = move | 2 << 14;
+                    moves[count++] = move | 1 << 14;
+                    moves[count++] = move;
+                } else {
+                    moves[count++] = move;
+                }
+            }
+        }
+    }
+
+    void addCastleMoves(int us, int castleRights, int *moves, int &count) const {
+        bool kingSide, queenSide;
+        int king;
+        if (us == WHITE) {
+            kingSide = castleRights & 1; queenSide = castleRights & 2; king = 60;
+        } else {
+            kingSide = castleRights & 4; queenSide = castleRights & 8; king = 4;
+        }
+        if (!(kingSide || queenSide) || squares[king] != us * 10 + 6)
+            return;
+        int them = 3 - us;
+        if (kingSide && !((occupied >> (king + 1)) & 3)) {
+            if (!isSquareAttacked(king + 1, them) && !isSquareAttacked(king + 2, them))
+                moves[count++] = king | (king + 2) << 6 | CASTLE << 12 | (us * 10 + 6) << 16;
+        }
+        if (queenSide && !((occupied >> (king - 3)) & 7)) {
+            if (!isSquareAttacked(king - 1, them) && !isSquareAttacked(king - 2, them))
+                moves[count++] = king | (king - 2) << 6 | CASTLE << 12 | (us * 10 + 6) << 16;
+        }
+    }
+
+    U64 pieceAttacks(int kind, int sq) const {
+        switch (kind) {
+            case 2: return KNIGHT_ATTACKS[sq];
+            case 3: return bishopAttacks(sq, occupied);
+            case 4: return rookAttacks(sq, occupied);
+            case 5: return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+            default: return KING_ATTACKS[sq];
+        }
+    }
+
+    int pseudoLegalMoves(int *moves) const {
+        int count = 0;
+        int us = whiteToMove ? WHITE : BLACK;
+        int base = us * 10;
+        U64 pawns = pieces[base + 1];
+        addPawnMoves(us, pawns, FULL, moves, count);
+        if (epSquare >= 0) {
+            U64 attackers = PAWN_ATTACKS[3 - us][epSquare] & pawns;
+            while (attackers) {
+                int start = lsb(attackers);
+                attackers &= attackers - 1;
+                moves[count++] = start | epSquare << 6 | EN_PASSANT << 12 | (base + 1) << 16
+                                 | ((3 - us) * 10 + 1) << 21;
+            }
+        }
+        U64 notOwn = ~colors[us];
+        for (int kind = 2; kind <= 6; kind++) {
+            U64 bb = pieces[base + kind];
+            while (bb) {
+                int start = lsb(bb);
+                bb &= bb - 1;
+                addTargets(start | (base + kind) << 16, pieceAttacks(kind, start) & notOwn, squares, moves, count);
+            }
+        }
+        if (!inCheck())
+            addCastleMoves(us, castleRights, moves, count);
+        return count;
+    }
+
+    // Same algorithm as Bitboard.Position.getLegalMoves: checkers and pins are found once, and only en
+    // passant is tested by making the move.
+    int legalMoves(int *moves) {
+        int count = 0;
+        int us = whiteToMove ? WHITE : BLACK;
+        int them = 3 - us;
+        U64 own = colors[us];
+        int base = us * 10, enemyBase = them * 10;
+        int king = kingSquare(us);
+        U64 enemyRooks = pieces[enemyBase + 4] | pieces[enemyBase + 5];
+        U64 enemyBishops = pieces[enemyBase + 3] | pieces[enemyBase + 5];
+
+        U64 kingBit = 1ULL << king;
+        U64 danger = attacks[them];
+        U64 checkers = 0;
+        if (danger & kingBit) {
+            checkers = (KNIGHT_ATTACKS[king] & pieces[enemyBase + 2])
+                       | (PAWN_ATTACKS[us][king] & pieces[enemyBase + 1])
+                       | (rookAttacks(king, occupied) & enemyRooks)
+                       | (bishopAttacks(king, occupied) & enemyBishops);
+            // extend the checking slider lines past the king, which blocks them in the attack map
+            U64 withoutKing = occupied ^ kingBit;
+            for (U64 sliders = checkers & (enemyRooks | enemyBishops); sliders; sliders &= sliders - 1) {
+                int sq = lsb(sliders);
+                danger |= (rookAttacks(sq, 0) & kingBit) ? rookAttacks(sq, withoutKing) : bishopAttacks(sq, withoutKing);
+            }
+        }
+
+        addTargets(king | (base + 6) << 16, KING_ATTACKS[king] & ~own & ~danger, squares, moves, count);
+        if (checkers & (checkers - 1))
+            return count;
+
+        U64 target;
+        if (checkers) {
+            target = checkers | BETWEEN[king][msb(checkers)];
+        } else {
+            target = ~own;
+            addCastleMoves(us, castleRights, moves, count);
+        }
+
+        U64 pinned = 0;
+        U64 pinRays[64];
+        int pinnedSquares[8];
+        int pinnedCount = 0;
+        U64 snipers = (rookAttacks(king, 0) & enemyRooks) | (bishopAttacks(king, 0) & enemyBishops);
+        while (snipers) {
+            int sniper = lsb(snipers);
+            snipers &= snipers - 1;
+            U64 between = BETWEEN[king][sniper] & occupied;
+            if ((between & own) && !(between & (between - 1))) {
+                int sq = lsb(between);
+                pinned |= between;
+                pinRays[sq] = BETWEEN[king][sniper] | (1ULL << sniper);
+                pinnedSquares[pinnedCount++] = sq;
+            }
+        }
+
+        U64 pawns = pieces[base + 1];
+        addPawnMoves(us, pawns & ~pinned, target, moves, count);
+        for (int i = 0; i < pinnedCount; i++) {
+            int sq = pinnedSquares[i];
+            if (squares[sq] == base + 1)
+                addPawnMoves(us, 1ULL << sq, target & pinRays[sq], moves, count);
+        }
+        if (epSquare >= 0) {
+            U64 attackers = PAWN_ATTACKS[them][epSquare] & pawns;
+            while (attackers) {
+                int from = lsb(attackers);
+                attackers &= attackers - 1;
+                int move = from | epSquare << 6 | EN_PASSANT << 12 | (base + 1) << 16 | (enemyBase + 1) << 21;
+                movePieces(move);
+                if (!isAttackedAfter(king, them, occupied, 0))
+                    moves[count++] = move;
+                unmovePieces(move);
+            }
+        }
+
+        for (int kind = 2; kind <= 5; kind++) {
+            U64 bb = pieces[base + kind];
+            while (bb) {
+                int from = lsb(bb);
+                U64 bit = bb & (0 - bb);
+                bb &= bb - 1;
+                if (kind == 2 && (bit & pinned))
+                    continue;
+                U64 t = pieceAttacks(kind, from) & target;
+                if (bit & pinned)
+                    t &= pinRays[from];
+                addTargets(from | (base + kind) << 16, t, squares, moves, count);
+            }
+        }
+        return count;
+    }
+
+    bool insufficientMaterial() const {
+        int count = popCount(occupied);
+        if (count == 2)
+            return true;
+        if (count == 3 && (pieces[12] | pieces[13] | pieces[22] | pieces[23]))
+            return true;
+        if (count == 4 && pieces[13] && pieces[23]) {
+            int first = msb(pieces[13]), second = msb(pieces[23]);
+            if ((first / 8 + first % 8) % 2 == (second / 8 + second % 8) % 2)
+                return true;
+        }
+        return false;
+    }
+};
+
+/* ---------------------------------------------------------------------------------------------
+ * Python wrapper
+ * ------------------------------------------------------------------------------------------- */
+
+// Bound for any board setBoard accepts, reachable or not: no piece has more than 27 moves (a queen in the
+// center; a pawn has at most 12, 3 targets times 4 promotions, and a king 10 with castling), and there are at
+// most 64 pieces. The most in a reachable position is 218, but unreachable material goes past 256.
+#define MAX_MOVES (64 * 27)
+
+typedef struct {
+    PyObject_HEAD
+    Board board;
+} PositionObject;
+
+static PyObject *U64ToPy(U64 value) {
+    return PyLong_FromUnsignedLongLong(value);
+}
+
+static inline bool isPiece(long piece) {
+    return (piece > 10 && piece < 17) || (piece > 20 && piece < 27);
+}
+
+// Check the fields of an encoded move against the position: the moved piece stands on the start square and
+// belongs to the side to move, and the captured piece is the one on the captured square
+static bool isConsistentMove(const Board &board, long move) {
+    if (move <= 0 || move >> 26)
+        return false;
+    int start = move & 63, end = move >> 6 & 63, flag = move >> 12 & 3;
+    int piece = move >> 16 & 31, captured = move >> 21 & 31;
+    int us = board.whiteToMove ? WHITE : BLACK;
+    if (start == end || piece != board.squares[start] || piece / 10 != us)
+        return false;
+    if (flag == EN_PASSANT)
+        return piece == us * 10 + 1 && captured == (3 - us) * 10 + 1 && board.squares[end] == 0
+               && board.squares[(start & ~7) | (end & 7)] == captured;
+    if (captured != board.squares[end] || (captured && captured / 10 == us))
+        return false;
+    if (flag == PROMOTION)
+        return piece == us * 10 + 1 && ((1ULL << end) & PROMOTION_ROWS) != 0;
+    if (flag == CASTLE)
+        return piece == us * 10 + 6 && (end - start == 2 || start - end == 2)
+               && board.squares[end > start ? end + 1 : end - 2] == us * 10 + 4;
+    return true;
+}
+
+// An en passant square is the empty square a pawn of the side not to move just skipped: on row 2 with white to
+// move, row 5 with black to move, with that pawn in front of it
+static bool isValidEpSquare(const Board &board, bool whiteToMove, int epSquare) {
+    if (epSquare == -1)
+        return true;
+    if (whiteToMove)
+        return epSquare >= 16 && epSquare < 24 && board.squares[epSquare] == 0 && board.squares[epSquare + 8] == 21;
+    return epSquare >= 40 && epSquare < 48 && board.squares[epSquare] == 0 && board.squares[epSquare - 8] == 11;
+}
+
+static PyObject *movesToList(const int *moves, int count) {
+    PyObject *list = PyList_New(count);
+    if (!list)
+        return NULL;
+    for (int i = 0; i < count; i++)
+        PyList_SET_ITEM(list, i, PyLong_FromLong(moves[i]));
+    return list;
+}
+
+// Replace the pieces, keep the other state and clear the undo stack, as Bitboard.Position.setBoard
+static int loadBoard(Board &board, PyObject *rows) {
+    board.clearPieces();
+    board.invalidateAccumulators();
+    board.ply = 0;
+    if (PySequence_Size(rows) != 8) {
+        PyErr_SetString(PyExc_ValueError, "board must have 8 rows");
+        return -1;
+    }
+    for (int r = 0; r < 8; r++) {
+        PyObject *row = PySequence_GetItem(rows, r);
+        if (!row)
+            return -1;
+        if (PySequence_Size(row) != 8) {
+            Py_DECREF(row);
+            PyErr_SetString(PyExc_ValueError, "board rows must have 8 squares");
+            return -1;
+        }
+        for (int c = 0; c < 8; c++) {
+            PyObject *item = PySequence_GetItem(row, c);
+            if (!item) {
+                Py_DECREF(row);
+                return -1;
+            }
+            long piece = PyLong_AsLong(item);
+            Py_DECREF(item);
+            if (piece == -1 && PyErr_Occurred()) {
+                Py_DECREF(row);
+                return -1;
+            }
+            if (piece != 0) {
+                if (!isPiece(piece)) {
+                    Py_DECREF(row);
+                    PyErr_Format(PyExc_ValueError, "invalid piece code %ld", piece);
+                    return -1;
+                }
+                board.putPiece(r * 8 + c, (int)piece);
+            }
+        }
+        Py_DECREF(row);
+    }
+    board.key = board.computeKey();
+    board.computeAttacks();
+    return 0;
+}
+
+static int Position_init(PositionObject *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"board", NULL};
+    PyObject *rows = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char **)kwlist, &rows))
+        return -1;
+    Board &board = self->board;
+    board.clearPieces();
+    board.invalidateAccumulators();
+    board.whiteToMove = true;
+    board.castleRights = 0;
+    board.epSquare = -1;
+    board.halfmoveClock = 0;
+    board.key = 0;
+    board.computeAttacks();
+    board.ply = 0;
+    if (!board.reserve(UNDO_STACK_PLIES)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (rows != Py_None)
+        return loadBoard(board, rows);
+    return 0;
+}
+
+static void Position_dealloc(PositionObject *self) {
+    PyMem_Free(self->board.stack);
+    PyMem_Free(self->board.accumulators);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Position_setState(PositionObject *self, PyObject *args) {
+    int whiteToMove, castleRights, epSquare, halfmoveClock;
+    if (!PyArg_ParseTuple(args, "piii", &whiteToMove, &castleRights, &epSquare, &halfmoveClock))
+        return NULL;
+    Board &board = self->board;
+    if (castleRights < 0 || castleRights > 15 || !isValidEpSquare(board, whiteToMove, epSquare)) {
+        PyErr_SetString(PyExc_ValueError, "invalid castling rights or en passant square");
+        return NULL;
+    }
+    board.whiteToMove = whiteToMove;
+    board.castleRights = castleRights;
+    board.epSquare = epSquare;
+    board.halfmoveClock = halfmoveClock;
+    board.key = board.computeKey();
+    board.ply = 0;
+    board.invalidateAccumulators();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_computeKey(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromUnsignedLongLong(self->board.computeKey());
+}
+
+static PyObject *Position_setBoard(PositionObject *self, PyObject *rows) {
+    if (loadBoard(self->board, rows) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_toBoard(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    PyObject *rows = PyList_New(8);
+    if (!rows)
+        return NULL;
+    for (int r = 0; r < 8; r++) {
+        PyObject *row = PyList_New(8);
+        if (!row) {
+            Py_DECREF(rows);
+            return NULL;
+        }
+        for (int c = 0; c < 8; c++)
+            PyList_SET_ITEM(row, c, PyLong_FromLong(self->board.squares[r * 8 + c]));
+        PyList_SET_ITEM(rows, r, row);
+    }
+    return rows;
+}
+
+static PyObject *Position_putPiece(PositionObject *self, PyObject *args) {
+    int sq, piece;
+    if (!PyArg_ParseTuple(args, "ii", &sq, &piece))
+        return NULL;
+    if (sq < 0 || sq > 63 || !isPiece(piece)) {
+        PyErr_SetString(PyExc_ValueError, "invalid square or piece");
+        return NULL;
+    }
+    self->board.putPiece(sq, piece);
+    self->board.invalidateAccumulators();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_removePiece(PositionObject *self, PyObject *arg) {
+    long sq = PyLong_AsLong(arg);
+    if (sq == -1 && PyErr_Occurred())
+        return NULL;
+    if (sq < 0 || sq > 63) {
+        PyErr_SetString(PyExc_ValueError, "invalid square");
+        return NULL;
+    }
+    self->board.invalidateAccumulators();
+    return PyLong_FromLong(self->board.removePiece((int)sq));
+}
+
+static PyObject *Position_kingSquare(PositionObject *self, PyObject *arg) {
+    long color = PyLong_AsLong(arg);
+    if (color == -1 && PyErr_Occurred())
+        return NULL;
+    if (color < WHITE || color > BLACK) {
+        PyErr_SetString(PyExc_ValueError, "invalid color");
+        return NULL;
+    }
+    return PyLong_FromLong(self->board.kingSquare((int)color));
+}
+
+static PyObject *Position_enPassantKey(PositionObject *self, PyObject *args) {
+    int epSquare, us;
+    if (!PyArg_ParseTuple(args, "ii", &epSquare, &us))
+        return NULL;
+    return U64ToPy(self->board.enPassantKey(epSquare, us));
+}
+
+static PyObject *Position_mobility(PositionObject *self, PyObject *arg) {
+    long color = PyLong_AsLong(arg);
+    if (color == -1 && PyErr_Occurred())
+        return NULL;
+    if (color < WHITE || color > BLACK) {
+        PyErr_SetString(PyExc_ValueError, "invalid color");
+        return NULL;
+    }
+    return PyLong_FromLong(self->board.mobility((int)color));
+}
+
+static PyObject *Position_isSquareAttacked(PositionObject *self, PyObject *args) {
+    int sq, byColor;
+    if (!PyArg_ParseTuple(args, "ii", &sq, &byColor))
+        return NULL;
+    if (sq < 0 || sq > 63 || byColor < WHITE || byColor > BLACK) {
+        PyErr_SetString(PyExc_ValueError, "invalid square or color");
+        return NULL;
+    }
+    return PyBool_FromLong(self->board.isSquareAttacked(sq, byColor));
+}
+
+static PyObject *Position_inCheck(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyBool_FromLong(self->board.inCheck());
+}
+
+static PyObject *Position_makeMove(PositionObject *self, PyObject *arg) {
+    long move = PyLong_AsLong(arg);
+    if (move == -1 && PyErr_Occurred())
+        return NULL;
+    if (!isConsistentMove(self->board, move)) {
+        PyErr_Format(PyExc_ValueError, "move %ld does not fit the position", move);
+        return NULL;
+    }
+    if (!self->board.makeMove((int)move))
+        return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_makeNullMove(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->board.makeNullMove())
+        return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_undoMove(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->board.ply == 0) {
+        PyErr_SetString(PyExc_IndexError, "undo stack is empty");
+        return NULL;
+    }
+    return PyLong_FromLong(self->board.undoMove());
+}
+
+static PyObject *Position_lastMove(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    const Board &board = self->board;
+    return PyLong_FromLong(board.ply ? board.stack[board.ply - 1].move : 0);
+}
+
+static PyObject *Position_getPseudoLegalMoves(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    int moves[MAX_MOVES];
+    int count = self->board.pseudoLegalMoves(moves);
+    return movesToList(moves, count);
+}
+
+static PyObject *Position_getLegalMoves(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->board.kingSquare(self->board.whiteToMove ? WHITE : BLACK) < 0) {
+        PyErr_SetString(PyExc_ValueError, "the side to move has no king");
+        return NULL;
+    }
+    int moves[MAX_MOVES];
+    int count = self->board.legalMoves(moves);
+    return movesToList(moves, count);
+}
+
+static PyObject *Position_evaluateNnue(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!network) {
+        PyErr_SetString(PyExc_RuntimeError, "no network loaded");
+        return NULL;
+    }
+    if (!self->board.reserveAccumulators())
+        return PyErr_NoMemory();
+    return PyLong_FromLong(self->board.evaluateNnue());
+}
+
+static PyObject *Position_insufficientMaterial(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyBool_FromLong(self->board.insufficientMaterial());
+}
+
+// Pickled as the board plus (side to move, castling rights, en passant square, halfmove clock, undo stack)
+static PyObject *Position_reduce(PositionObject *self, PyObject *Py_UNUSED(ignored)) {
+    const Board &board = self->board;
+    PyObject *rows = Position_toBoard(self, NULL);
+    if (!rows)
+        return NULL;
+    return Py_BuildValue("(O(N)(Oiiiy#))", (PyObject *)Py_TYPE(self), rows, board.whiteToMove ? Py_True : Py_False,
+                         board.castleRights, board.epSquare, board.halfmoveClock, (const char *)board.stack,
+                         (Py_ssize_t)(board.ply * sizeof(UndoRecord)));
+}
+
+static PyObject *Position_setstate(PositionObject *self, PyObject *state) {
+    int whiteToMove, castleRights, epSquare, halfmoveClock;
+    const char *stack;
+    Py_ssize_t size;
+    if (!PyArg_ParseTuple(state, "piiiy#", &whiteToMove, &castleRights, &epSquare, &halfmoveClock, &stack, &size))
+        return NULL;
+    Board &board = self->board;
+    if (castleRights < 0 || castleRights > 15 || !isValidEpSquare(board, whiteToMove, epSquare)) {
+        PyErr_SetString(PyExc_ValueError, "invalid castling rights or en passant square");
+        return NULL;
+    }
+    int plies = (int)(size / sizeof(UndoRecord));
+    if (!board.reserve(plies))
+        return PyErr_NoMemory();
+    board.whiteToMove = whiteToMove;
+    board.castleRights = castleRights;
+    board.epSquare = epSquare;
+    board.halfmoveClock = halfmoveClock;
+    board.key = board.computeKey();
+    memcpy(board.stack, stack, plies * sizeof(UndoRecord));
+    board.ply = plies;
+    board.invalidateAccumulators();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Position_getSquares(PositionObject *self, void *Py_UNUSED(closure)) {
+    PyObject *list = PyList_New(64);
+    if (!list)
+        return NULL;
+    for (int sq = 0; sq < 64; sq++)
+        PyList_SET_ITEM(list, sq, PyLong_FromLong(self->board.squares[sq]));
+    return list;
+}
+
+static PyObject *Position_getPieces(PositionObject *self, void *Py_UNUSED(closure)) {
+    PyObject *list = PyList_New(27);
+    if (!list)
+        return NULL;
+    for (int piece = 0; piece < 27; piece++)
+        PyList_SET_ITEM(list, piece, U64ToPy(self->board.pieces[piece]));
+    return list;
+}
+
+static PyObject *Position_getColors(PositionObject *self, void *Py_UNUSED(closure)) {
+    return Py_BuildValue("[KKK]", 0ULL, (unsigned long long)self->board.colors[1],
+                         (unsigned long long)self->board.colors[2]);
+}
+
+static PyObject *Position_getOccupied(PositionObject *self, void *Py_UNUSED(closure)) {
+    return U64ToPy(self->board.occupied);
+}
+
+static PyObject *Position_getAttacks(PositionObject *self, void *Py_UNUSED(closure)) {
+    const U64 *attacks = self->board.attacks;
+    return Py_BuildValue("[iNN]", 0, U64ToPy(attacks[WHITE]), U64ToPy(attacks[BLACK]));
+}
+
+static PyObject *Position_getKey(PositionObject *self, void *Py_UNUSED(closure)) {
+    return U64ToPy(self->board.key);
+}
+
+static PyObject *Position_getPawnKey(PositionObject *self, void *Py_UNUSED(closure)) {
+    return U64ToPy(self->board.pawnKey);
+}
+
+static PyObject *Position_getPieceSquareScore(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromLong(self->board.pieceSquareScore);
+}
+
+static PyObject *Position_getWhiteToMove(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyBool_FromLong(self->board.whiteToMove);
+}
+
+static PyObject *Position_getCastleRights(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromLong(self->board.castleRights);
+}
+
+static PyObject *Position_getEpSquare(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromLong(self->board.epSquare);
+}
+
+static PyObject *Position_getHalfmoveClock(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromLong(self->board.halfmoveClock);
+}
+
+static PyObject *Position_getPly(PositionObject *self, void *Py_UNUSED(closure)) {
+    return PyLong_FromLong(self->board.ply);
+}
+
+static PyMethodDef Position_methods[] = {
+    {"setBoard", (PyCFunction)Position_setBoard, METH_O, "Load the piece placement from an 8x8 array of piece codes."},
+    {"setState", (PyCFunction)Position_setState, METH_VARARGS, "Set side to move, castling rights, en passant square and halfmove clock."},
+    {"computeKey", (PyCFunction)Position_computeKey, METH_NOARGS, "Zobrist key computed from scratch."},
+    {"toBoard", (PyCFunction)Position_toBoard, METH_NOARGS, "8x8 list of piece codes."},
+    {"putPiece", (PyCFunction)Position_putPiece, METH_VARARGS, "Place a piece on an empty square."},
+    {"removePiece", (PyCFunction)Position_removePiece, METH_O, "Remove the piece standing on a square and return it."},
+    {"kingSquare", (PyCFunction)Position_kingSquare, METH_O, "Square of the king of a side (1 white, 2 black), -1 if it has none."},
+    {"enPassantKey", (PyCFunction)Position_enPassantKey, METH_VARARGS, "Zobrist key of an en passant square, 0 if unusable."},
+    {"mobility", (PyCFunction)Position_mobility, METH_O, "Pseudo-legal move count of a side (1 white, 2 black), without castling and en passant."},
+    {"isSquareAttacked", (PyCFunction)Position_isSquareAttacked, METH_VARARGS, "Check if a square is attacked by a side, read from the attack maps."},
+    {"inCheck", (PyCFunction)Position_inCheck, METH_NOARGS, "Check if the side to move is in check."},
+    {"makeMove", (PyCFunction)Position_makeMove, METH_O, "Make an encoded move and push the undo record."},
+    {"makeNullMove", (PyCFunction)Position_makeNullMove, METH_NOARGS, "Pass the turn, pushing a null move record."},
+    {"undoMove", (PyCFunction)Position_undoMove, METH_NOARGS, "Take back the last move and return it."},
+    {"lastMove", (PyCFunction)Position_lastMove, METH_NOARGS, "Last move made, 0 if the undo stack is empty."},
+    {"getPseudoLegalMoves", (PyCFunction)Position_getPseudoLegalMoves, METH_NOARGS, "Encoded pseudo-legal moves."},
+    {"getLegalMoves", (PyCFunction)Position_getLegalMoves, METH_NOARGS, "Encoded legal moves."},
+    {"insufficientMaterial", (PyCFunction)Position_insufficientMaterial, METH_NOARGS, "Check for insufficient mating material."},
+    {"evaluateNnue", (PyCFunction)Position_evaluateNnue, METH_NOARGS, "Score of the loaded network for the side to move, in hundredths."},
+    {"__reduce__", (PyCFunction)Position_reduce, METH_NOARGS, "Pickle support."},
+    {"__setstate__", (PyCFunction)Position_setstate, METH_O, "Pickle support."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef Position_getset[] = {
+    {"squares", (getter)Position_getSquares, NULL, "64-entry mailbox of piece codes (a copy).", NULL},
+    {"pieces", (getter)Position_getPieces, NULL, "Bitboard per piece code (a copy).", NULL},
+    {"colors", (getter)Position_getColors, NULL, "Occupancy of white (index 1) and black (index 2).", NULL},
+    {"occupied", (getter)Position_getOccupied, NULL, "Occupancy of both sides.", NULL},
+    {"attacks", (getter)Position_getAttacks, NULL, "Squares attacked by white (index 1) and black (index 2).", NULL},
+    {"key", (getter)Position_getKey, NULL, "Zobrist key of the position.", NULL},
+    {"pawnKey", (getter)Position_getPawnKey, NULL, "Zobrist key of the pawns alone.", NULL},
+    {"pieceSquareScore", (getter)Position_getPieceSquareScore, NULL, "Sum of the piece-square scores of the pieces, in hundredths.", NULL},
+    {"whiteToMove", (getter)Position_getWhiteToMove, NULL, "Side to move.", NULL},
+    {"castleRights", (getter)Position_getCastleRights, NULL, "Castling rights bits.", NULL},
+    {"epSquare", (getter)Position_getEpSquare, NULL, "En passant square, -1 if none.", NULL},
+    {"halfmoveClock", (getter)Position_getHalfmoveClock, NULL, "Plies since the last capture or pawn move.", NULL},
+    {"ply", (getter)Position_getPly, NULL, "Number of moves on the undo stack.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject PositionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+// Set the scores pieceSquareScore adds up, as Bitboard.setPieceSquareScores
+static PyObject *setPieceSquareScores(PyObject *Py_UNUSED(module), PyObject *table) {
+    int scores[27][64];
+    if (PySequence_Size(table) != 27) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "piece-square table must have 27 rows of 64 squares");
+        return NULL;
+    }
+    for (int piece = 0; piece < 27; piece++) {
+        PyObject *row = PySequence_GetItem(table, piece);
+        if (!row)
+            return NULL;
+        if (PySequence_Size(row) != 64) {
+            Py_DECREF(row);
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_ValueError, "piece-square table must have 27 rows of 64 squares");
+            return NULL;
+        }
+        for (int sq = 0; sq < 64; sq++) {
+            PyObject *item = PySequence_GetItem(row, sq);
+            if (!item) {
+                Py_DECREF(row);
+                return NULL;
+            }
+            long score = PyLong_AsLong(item);
+            Py_DECREF(item);
+            if (score == -1 && PyErr_Occurred()) {
+                Py_DECREF(row);
+                return NULL;
+            }
+            scores[piece][sq] = (int)score;
+        }
+        Py_DECREF(row);
+    }
+    memcpy(PIECE_SQUARE_SCORES, scores, sizeof(scores));
+    Py_RETURN_NONE;
+}
+
+// Copy the next count items of a network file, checked against its end
+static bool readNetworkArray(const char *&data, const char *end, void *out, size_t itemSize, size_t count) {
+    size_t size = itemSize * count;
+    if ((size_t)(end - data) < size)
+        return false;
+    memcpy(out, data, size);
+    data += size;
+    return true;
+}
+
+// Load the network from the bytes of a file in the format of Nnue.py (little-endian), or unload it with None
+static PyObject *loadNetwork(PyObject *Py_UNUSED(module), PyObject *arg) {
+    if (arg == Py_None) {
+        PyMem_Free(network);
+        network = NULL;
+        Py_RETURN_NONE;
+    }
+    Py_buffer view;
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0)
+        return NULL;
+    const char *data = (const char *)view.buf, *end = data + view.len;
+    int32_t header[5];  // features, L1, L2, L3, output scale
+    if (view.len < 8 || memcmp(data, "DQKNNUE1", 8) != 0) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "not a network file");
+        return NULL;
+    }
+    data += 8;
+    if (!readNetworkArray(data, end, header, sizeof(int32_t), 5) || header[0] != NNUE_FEATURES
+        || header[1] != NNUE_L1 || header[2] != NNUE_L2 || header[3] != NNUE_L3) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "network layers must be %d x %d x %d x %d x 1", NNUE_FEATURES, NNUE_L1,
+                     NNUE_L2, NNUE_L3);
+        return NULL;
+    }
+    Network *loaded = (Network *)PyMem_Malloc(sizeof(Network));
+    if (!loaded) {
+        PyBuffer_Release(&view);
+        return PyErr_NoMemory();
+    }
+    loaded->outputScale = header[4];
+    bool complete = readNetworkArray(data, end, loaded->featureBias, sizeof(int16_t), NNUE_L1)
+                    && readNetworkArray(data, end, loaded->featureWeights, sizeof(int16_t), NNUE_FEATURES * NNUE_L1)
+                    && readNetworkArray(data, end, loaded->hidden1Bias, sizeof(int32_t), NNUE_L2)
+                    && readNetworkArray(data, end, loaded->hidden1Weights, sizeof(int8_t), NNUE_L2 * 2 * NNUE_L1)
+                    && readNetworkArray(data, end, loaded->hidden2Bias, sizeof(int32_t), NNUE_L3)
+                    && readNetworkArray(data, end, loaded->hidden2Weights, sizeof(int8_t), NNUE_L3 * NNUE_L2)
+                    && readNetworkArray(data, end, &loaded->outputBias, sizeof(int32_t), 1)
+                    && readNetworkArray(data, end, loaded->outputWeights, sizeof(int8_t), NNUE_L3)
+                    && data == end;
+    PyBuffer_Release(&view);
+    if (!complete) {
+        PyMem_Free(loaded);
+        PyErr_SetString(PyExc_ValueError, "network file has the wrong size");
+        return NULL;
+    }
+    PyMem_Free(network);
+    network = loaded;
+    networkVersion++;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef chesscoreMethods[] = {
+    {"setPieceSquareScores", (PyCFunction)setPieceSquareScores, METH_O, "Set the material and piece-square scores (27 rows of 64 ints, hundredths)."},
+    {"loadNetwork", (PyCFunction)loadNetwork, METH_O, "Load the NNUE network from the bytes of a network file, or unload it with None."},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef chesscoreModule = {
+    PyModuleDef_HEAD_INIT,
+    "chesscore",
+    "Native bitboard position, move generation, make/undo, Zobrist hashing, piece-square scores and NNUE evaluation.",
+    -1,
+    chesscoreMethods,
+};
+
+PyMODINIT_FUNC PyInit_chesscore(void) {
+    initTables();
+    initZobrist();
+    initCastleMask();
+
+    PositionType.tp_name = "chesscore.Position";
+    PositionType.tp_doc = "Chess position stored as bitboards, with make/undo on a preallocated undo stack.";
+    PositionType.tp_basicsize = sizeof(PositionObject);
+    PositionType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PositionType.tp_new = PyType_GenericNew;
+    PositionType.tp_init = (initproc)Position_init;
+    PositionType.tp_dealloc = (destructor)Position_dealloc;
+    PositionType.tp_methods = Position_methods;
+    PositionType.tp_getset = Position_getset;
+    if (PyType_Ready(&PositionType) < 0)
+        return NULL;
+
+    PyObject *module = PyModule_Create(&chesscoreModule);
+    if (!module)
+        return NULL;
+    Py_INCREF(&PositionType);
+    if (PyModule_AddObject(module, "Position", (PyObject *)&PositionType) < 0) {
+        Py_DECREF(&PositionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    if (PyModule_AddStringConstant(module, "NNUE_SIMD", NNUE_SIMD) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
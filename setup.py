@@ -0,0 +1,27 @@
+"""
+Build script for the native position core (chesscore). The game runs without it, on the pure Python
+Bitboard module, but move generation is much faster with it.
+
+Build in place with: python setup.py build_ext --inplace
+Set CHESSCORE_NATIVE=1 to compile for the instruction set of this machine (AVX2 NNUE kernel).
+
+Author: Doan Quoc Kien
+"""
+import os
+import sys
+from setuptools import setup, Extension
+
+if sys.platform == "win32":
+    compileArgs = ["/O2", "/std:c++17"]
+else:
+    compileArgs = ["-O3", "-std=c++17"]
+if os.environ.get("CHESSCORE_NATIVE") == "1":
+    compileArgs.append("/arch:AVX2" if sys.platform == "win32" else "-march=native")
+
+setup(
+    name="chesscore",
+    version="1.0",
+    description="Native bitboard position and move generation for ChessByDQK",
+    ext_modules=[Extension("chesscore", sources=["chesscore.cpp"], language="c++",
+                           extra_compile_args=compileArgs)],
+)